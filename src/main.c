@@ -20,59 +20,222 @@
 
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <string.h>
 
 #include "winwrangler.h"
 
 static gchar *layout_name = NULL;
+static gboolean all_workspaces = FALSE;
 static gboolean print_layouts = FALSE;
 static gboolean run_tray = FALSE;
 static gboolean run_daemon = FALSE;
+static gboolean dry_run = FALSE;
+static gboolean print_stats = FALSE;
+static gboolean save_arrangement = FALSE;
+static gboolean restore_arrangement = FALSE;
+static gchar *arrangement_file = NULL;
 
 static GOptionEntry option_entries[] = {
 	{ "layout", 'l', 0, G_OPTION_ARG_STRING, &layout_name,
 	  N_("The layout function to apply") },
+	{ "all-workspaces", 'A', 0, G_OPTION_ARG_NONE, &all_workspaces,
+	  N_("Apply the layout to all workspaces and viewports, not just the "
+	     "current one") },
 	{ "layouts", 0, 0, G_OPTION_ARG_NONE, &print_layouts,
 	  N_("Print a list of layout functions") },
 	{ "tray", 't', 0, G_OPTION_ARG_NONE, &run_tray,
 	  N_("Add an icon in the system tray. This implies --daemon") },
 	{ "daemon", 'd', 0, G_OPTION_ARG_NONE, &run_daemon,
 	  N_("Run a background process listening for hotkey events") },
+	{ "dry-run", 'n', 0, G_OPTION_ARG_NONE, &dry_run,
+	  N_("Print the geometry changes of a layout instead of applying them") },
+	{ "stats", 's', 0, G_OPTION_ARG_NONE, &print_stats,
+	  N_("Print layout latency statistics when done. A running daemon logs "
+	     "them on SIGUSR1") },
+	{ "save", 0, 0, G_OPTION_ARG_NONE, &save_arrangement,
+	  N_("Save the workspace and geometry of all windows") },
+	{ "restore", 0, 0, G_OPTION_ARG_NONE, &restore_arrangement,
+	  N_("Move all windows back to where they were saved with --save") },
+	{ "arrangement", 'a', 0, G_OPTION_ARG_FILENAME, &arrangement_file,
+	  N_("The file used by --save and --restore"), N_("FILE") },
 	{ NULL }
 };
 
 static void
-do_print_layouts (const WwLayout *layouts)
+do_print_layouts (GList *layouts)
 {
-	WwLayout *layout;
+	const WwLayout	*layout;
+	GList			*iter;
 	
 	g_return_if_fail (layouts != NULL);
 	
 	g_print ("Known layouts:\n");
-	for (layout = layouts; layout->name != NULL; layout++)
+	for (iter = layouts; iter; iter = iter->next)
 	{
-		g_return_if_fail (layout != NULL);
+		layout = iter->data;
 		g_print (" - %-15s %s\n", layout->name, layout->desc);
 	}
 }
 
+static gboolean
+on_sigusr1 (gpointer data)
+{
+	ww_stats_log ();
+	ww_model_log_neighbours ();
+	return TRUE;
+}
+
+static gboolean
+on_quit_signal (gpointer data)
+{
+	gtk_main_quit ();
+	return FALSE;
+}
+
 void
 do_bind_keys (void)
 {
-	WwLayout *iter, *layouts;
+	GList *iter;
 	
-	layouts = ww_get_layouts ();
+	for (iter = ww_get_layouts (); iter; iter = iter->next)
+		ww_hotkey_bind_layout (iter->data);
+}
+
+/* Load the layout modules shipped with winwrangler, the ones installed by
+ * the user and the layouts defined in the user's layouts file, in that
+ * order */
+static void
+do_load_modules (void)
+{
+	gchar *user_dir;
+	gchar *user_file;
+	
+	ww_load_layout_modules (WW_LAYOUT_MODULE_DIR);
+	
+	user_dir = g_build_filename (g_get_user_data_dir (), "winwrangler",
+								 "layouts", NULL);
+	ww_load_layout_modules (user_dir);
+	g_free (user_dir);
+	
+	user_file = g_build_filename (g_get_user_config_dir (), "winwrangler",
+								  "layouts.conf", NULL);
+	ww_load_user_layouts (user_file);
+	g_free (user_file);
+}
+
+/* Look at the main options only, to pick a startup path before anything
+ * is initialised. Unknown options are left for the full parse */
+static gboolean
+do_parse_mode (int argc, char *argv[])
+{
+	GOptionContext	*options;
+	gchar			**args;
+	gboolean		result;
+	
+	args = g_new0 (gchar*, argc + 1);
+	memcpy (args, argv, argc * sizeof (gchar*));
+	
+	options = g_option_context_new (NULL);
+	g_option_context_add_main_entries (options, option_entries,
+									   GETTEXT_PACKAGE);
+	g_option_context_set_ignore_unknown_options (options, TRUE);
+	g_option_context_set_help_enabled (options, FALSE);
+	result = g_option_context_parse (options, &argc, &args, NULL);
+	g_option_context_free (options);
+	g_free (args);
+	
+	return result;
+}
+
+/* Whether the requested mode runs a main loop or shows widgets. Without an
+ * action the help is shown, which includes the GTK options */
+static gboolean
+needs_gtk (void)
+{
+	return run_daemon || run_tray ||
+		   !(layout_name || print_layouts ||
+			 save_arrangement || restore_arrangement);
+}
+
+/* Hand --layout to a running daemon, which has the window model warm.
+ * This only needs GLib, so it runs before the display is opened.
+ * Returns FALSE if the layout has to be applied in process */
+static gboolean
+do_forward_layout (int *status)
+{
+	GError			*error;
+	gint64			round_trip;
+	
+	if (layout_name == NULL || dry_run || print_layouts ||
+		save_arrangement || restore_arrangement)
+		return FALSE;
+	
+	error = NULL;
+	if (!ww_ipc_forward_layout (layout_name, all_workspaces,
+								&round_trip, &error))
+		return FALSE;
 	
-	for (iter = layouts; iter->name != NULL; iter++)
-		ww_hotkey_bind_layout (iter);
+	*status = 0;
+	if (error)
+	{
+		g_printerr (_("Failed to apply layout: %s\n"), error->message);
+		g_error_free (error);
+		*status = 1;
+	}
+	
+	ww_stats_startup_done ("forward");
+	
+	if (print_stats)
+	{
+		g_print ("Layout '%s' applied by the daemon, round trip %.3f ms\n",
+				 layout_name, round_trip / 1000.0);
+		ww_stats_print ();
+	}
+	else
+		g_debug ("Layout '%s' applied by the daemon, round trip %.3f ms",
+				 layout_name, round_trip / 1000.0);
+	
+	return TRUE;
+}
+
+static gboolean
+do_arrangement (void)
+{
+	GError	*error;
+	gchar	*path;
+	
+	path = arrangement_file ? g_strdup (arrangement_file)
+							: ww_arrangement_get_default_path ();
+	
+	error = NULL;
+	if (save_arrangement)
+		ww_arrangement_save (path, &error);
+	else
+		ww_arrangement_restore (path, &error);
+	
+	if (error)
+	{
+		g_printerr (_("Failed to %s window arrangement: %s\n"),
+					save_arrangement ? "save" : "restore", error->message);
+		g_error_free (error);
+	}
+	
+	g_free (path);
+	
+	return error == NULL;
 }
 
 int
 main (int argc, char *argv[])
 {
-	const WwLayout  *layouts;
+	GList			*layouts;
 	GError			*error;
 	GOptionContext  *options;
 	GtkStatusIcon	*tray_icon;
+	gboolean		with_gtk;
+	int				status;
 	
 #ifdef ENABLE_NLS
 	bindtextdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR);
@@ -80,14 +243,49 @@ main (int argc, char *argv[])
 	textdomain (GETTEXT_PACKAGE);
 #endif
 	
-	gtk_init (&argc, &argv);
+	ww_stats_startup_begin ();
+	
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+	/* --all-workspaces lays out the workspaces in threads */
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+#endif
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+	
+	/* One-shot modes skip GTK. --layouts doesn't even need the display,
+	 * and layouts only need the X connection, so GDK is enough */
+	with_gtk = !do_parse_mode (argc, argv) || needs_gtk ();
+	
+	if (!with_gtk)
+	{
+		if (do_forward_layout (&status))
+			return status;
+		
+		if (print_layouts)
+		{
+			do_load_modules ();
+			do_print_layouts (ww_get_layouts ());
+			ww_stats_startup_done ("layouts");
+			if (print_stats)
+				ww_stats_print ();
+			return 0;
+		}
+		
+		gdk_init (&argc, &argv);
+	}
+	else
+		gtk_init (&argc, &argv);
 	
+	do_load_modules ();
 	layouts = ww_get_layouts ();
 	
 	options = g_option_context_new (NULL);
 	g_option_context_add_main_entries (options, option_entries,
 									   GETTEXT_PACKAGE);
-	g_option_context_add_group (options, gtk_get_option_group (TRUE));
+	if (with_gtk)
+		g_option_context_add_group (options, gtk_get_option_group (TRUE));
 	
 	error = NULL;
 	if (!g_option_context_parse (options, &argc, &argv, &error))
@@ -96,27 +294,75 @@ main (int argc, char *argv[])
 		return 1;
 	}
 	
+	ww_set_dry_run (dry_run);
+	
 	if (print_layouts)
 	{
 		do_print_layouts (layouts);
 	}
+	else if (layout_name && all_workspaces)
+	{
+		if (!ww_apply_layout_everywhere (layout_name, &error))
+		{
+			g_printerr (_("Failed to apply layout: %s\n"), error->message);
+			g_error_free (error);
+			return 1;
+		}
+	}
 	else if (layout_name)
 	{
-		ww_apply_layout_by_name (layout_name);
+		if (!ww_apply_layout_by_name (layout_name, &error))
+		{
+			g_printerr (_("Failed to apply layout: %s\n"), error->message);
+			g_error_free (error);
+			return 1;
+		}
+	}
+	else if (save_arrangement || restore_arrangement)
+	{
+		if (!do_arrangement ())
+			return 1;
 	}
 	
+	/* Stay until the window manager has answered, so the settle phase can
+	 * correct the windows that didn't get where they were sent */
+	if (!run_daemon && !run_tray)
+		ww_settle_wait ();
+	
+	if (print_stats && !run_daemon && !run_tray)
+		ww_stats_print ();
+	
 	if (run_tray) {
 		run_daemon = TRUE;
 		tray_icon = ww_tray_icon_new ();
 	}
 	
 	if (run_daemon) {
+		g_unix_signal_add (SIGUSR1, on_sigusr1, NULL);
+		g_unix_signal_add (SIGINT, on_quit_signal, NULL);
+		g_unix_signal_add (SIGTERM, on_quit_signal, NULL);
+		
+		/* Keep the neighbour graph current between hotkeys */
+		ww_model_refresh_when_idle ();
+		
+		error = NULL;
+		if (!ww_ipc_listen (&error))
+		{
+			g_warning ("Not accepting layout requests: %s", error->message);
+			g_error_free (error);
+		}
+		
 		do_bind_keys();
+		ww_stats_startup_done ("daemon");
 		gtk_main();
+		
+		ww_ipc_shutdown ();
 	}
 	
 	else if (!layout_name &&
 			 !print_layouts &&
+			 !save_arrangement &&
+			 !restore_arrangement &&
 			 !run_daemon &&
 			 !run_tray)
 	{
@@ -126,5 +372,8 @@ main (int argc, char *argv[])
 		return 1;
 	}
 	
+	if (print_stats && run_daemon)
+		ww_stats_print ();
+	
 	return 0;
 }
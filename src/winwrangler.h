@@ -32,14 +32,32 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 
+#include "ww-engine.h"
+#include "ww-program.h"
+#include "ww-spatial.h"
+
 G_BEGIN_DECLS
+/* Opaque types */
+typedef struct _WwPlan WwPlan;
+
 /* Function prototypes */
 typedef void (*WwLayoutHandler) (WnckScreen 	*screen,
-				 				 GList 			*windows,
-				 				 GList			*struts,
+				 				 WwSnapshot		*snapshot,
 				 				 WnckWindow		*active,
+								 WwPlan			*plan,
 								 GError			**error);
 
+/* How a layout may be coalesced with the requests around it, whether it
+ * can be undone and whether it needs the windows from the model */
+typedef enum
+{
+	WW_LAYOUT_IDEMPOTENT	= 1 << 0,	/* applying it twice is like once */
+	WW_LAYOUT_NO_UNDO		= 1 << 1,	/* don't record it for undo */
+	WW_LAYOUT_NO_SNAPSHOT	= 1 << 2,	/* the handler gets a NULL snapshot */
+	WW_LAYOUT_SUPERSEDES	= 1 << 3	/* places every window without looking
+										 * at the current geometries */
+} WwLayoutFlags;
+
 /* Structures */
 typedef struct
 {
@@ -47,22 +65,78 @@ typedef struct
   const gchar *label;
   const gchar *desc;
   const gchar *default_hotkey;
-  WwLayoutHandler handler;  
+  WwLayoutHandler handler;	/* if NULL compute is applied on its own */
+  WwEngineFunc compute;	/* the pure layout behind handler, if any */
+  guint flags;			/* WwLayoutFlags */
+  gconstpointer data;	/* passed to compute in the WwEngineInput */
 } WwLayout;
 
+/* Called once the dispatcher has applied a request, @error is set if the
+ * layout failed */
+typedef void (*WwDispatchNotify) (const WwLayout	*layout,
+								  const GError		*error,
+								  gpointer			data);
+
+/* The phases of applying a layout, as recorded by ww_stats_record() */
+typedef enum
+{
+	WW_PHASE_HOTKEY,	/* the whole hotkey callback */
+	WW_PHASE_REFRESH,	/* getting the windows from the model */
+	WW_PHASE_COMPUTE,	/* running the layout handler */
+	WW_PHASE_COMMIT,	/* sending the plan to the X server */
+	WW_PHASE_TOTAL,		/* all of ww_apply_layout_by_name() */
+	WW_PHASE_STARTUP,	/* main() until the first change was sent, see
+						 * ww_stats_startup_done() */
+	WW_PHASE_SETTLE,	/* the commit until the windows got there, see
+						 * ww_settle_start() */
+	WW_N_PHASES
+} WwPhase;
+
+/* The counters of the hotkey dispatcher and the settle phase, see
+ * ww_stats_count() */
 typedef enum
 {
-	LEFT,
-	RIGHT,
-	UP,
-	DOWN
-} WwDirection;
+	WW_COUNTER_REQUESTS,		/* hotkey activations */
+	WW_COUNTER_COALESCED,		/* repeats merged into a queued request */
+	WW_COUNTER_ACTIVATIONS,		/* window activations sent to X */
+	WW_COUNTER_FOCUS_COALESCED,	/* activations skipped for a later one */
+	WW_COUNTER_SETTLE_PASSES,	/* request batches sent by settle phases */
+	WW_COUNTER_CORRECTIONS,		/* windows asked again to reach a target */
+	WW_COUNTER_UNSETTLED,		/* windows left off target */
+	WW_N_COUNTERS
+} WwCounter;
 
 /* Constants */
 #define WW_MOVERESIZE_FLAGS WNCK_WINDOW_CHANGE_WIDTH | WNCK_WINDOW_CHANGE_HEIGHT | WNCK_WINDOW_CHANGE_X | WNCK_WINDOW_CHANGE_Y
 
+/* Errors in the WW_ERROR domain */
+#define WW_ERROR ww_error_quark ()
+
+typedef enum
+{
+	WW_ERROR_BAD_FORMAT,		/* a file is not in the expected format */
+	WW_ERROR_DAEMON,			/* the daemon failed to carry out a request */
+	WW_ERROR_DAEMON_RUNNING,	/* another daemon owns the socket */
+	WW_ERROR_NO_SUCH_LAYOUT,	/* no layout has the requested name */
+	WW_ERROR_UNSUPPORTED		/* the layout can't be applied that way */
+} WwError;
+
+/* Monitor number meaning the whole screen */
+#define WW_MONITOR_ALL -1
+
+/* Layout modules export a function with this name and signature. It
+ * should call ww_register_layout() for each layout in the module */
+#define WW_LAYOUT_MODULE_INIT "ww_layout_module_init"
+typedef void (*WwLayoutModuleInitFunc) (void);
+
 /* Functions implemented in ww-layouts.c */
-const WwLayout*		ww_get_layouts			(void);
+gboolean			ww_register_layout		(const WwLayout *layout);
+
+guint				ww_load_layout_modules	(const gchar *dir);
+
+guint				ww_load_user_layouts	(const gchar *path);
+
+GList*				ww_get_layouts			(void);
 
 const WwLayout*		ww_get_layout			(const gchar *layout_name);
 
@@ -70,27 +144,50 @@ guint				ww_get_num_layouts		(void);
 
 
 /* Functions in ww-utils.c */
-GList*				ww_filter_user_windows		(GList *windows,
-												 WnckWorkspace *current);
+GQuark				ww_error_quark				(void);
 
-GList*				ww_filter_strut_windows		(GList *windows,
-												 WnckWorkspace *current);
+void				ww_describe_window			(WnckWindow *win,
+												 WnckWorkspace *current,
+												 WwWindowDesc *desc);
+
+void				ww_forget_size_hints		(WnckWindow *win);
+
+void				ww_forget_frame_extents		(WnckWindow *win);
+
+void				ww_window_set_geometry		(WnckWindow *win,
+												 int x,
+												 int y,
+												 int width,
+												 int height);
 
 GtkStatusIcon*		ww_tray_icon_new			(void);
 
-gboolean			ww_hotkey_bind_layout		(WwLayout *layout);
+gboolean			ww_hotkey_bind_layout		(const WwLayout *layout);
+
+gboolean			ww_apply_layout_by_name		(const gchar *layout_name,
+												 GError **error);
+
+void				ww_calc_bounds				(WwSnapshot *snapshot,
+												 WwRect *bounds);
 
-void				ww_apply_layout_by_name		(const gchar *layout_name);
+gboolean			ww_apply_engine				(WwEngineFunc func,
+												 WwSnapshot *snapshot,
+												 WwPlan *plan);
 
-void				ww_calc_bounds				(WnckScreen	*screen,
-												 GList *struts,
-												 int *left,
-												 int *top,
-												 int *right,
-												 int *bottom);
+gboolean			ww_apply_engine_full		(WwEngineFunc func,
+												 gconstpointer data,
+												 WwSnapshot *snapshot,
+												 WwPlan *plan);
 
-WnckWindow*			ww_find_neighbour			(WnckScreen		*screen,
-												 GList			*windows,
+gboolean			ww_apply_engine_active		(WwEngineFunc func,
+												 WwSnapshot *snapshot,
+												 WwPlan *plan);
+
+void				ww_window_center			(WnckWindow *win,
+												 int *center_x,
+												 int *center_y);
+
+WnckWindow*			ww_find_neighbour			(WwSpatialIndex	*index,
 						                         WnckWindow		*active,
 						                         WwDirection	direction);
 
@@ -98,5 +195,135 @@ guint32				ww_get_event_time			(void);
 
 void				ww_set_event_time			(guint32 event_time);
 
+gboolean			ww_get_dry_run				(void);
+
+void				ww_set_dry_run				(gboolean dry_run);
+
+/* Functions in ww-plan.c */
+WwPlan*				ww_plan_new					(void);
+
+void				ww_plan_free				(WwPlan *plan);
+
+void				ww_plan_set_geometry		(WwPlan *plan,
+												 WnckWindow *window,
+												 int x,
+												 int y,
+												 int width,
+												 int height);
+
+guint				ww_plan_get_length			(WwPlan *plan);
+
+WnckWindow*			ww_plan_get_geometry		(WwPlan *plan,
+												 guint index,
+												 int *x,
+												 int *y,
+												 int *width,
+												 int *height);
+
+void				ww_plan_print				(WwPlan *plan);
+
+guint				ww_plan_commit				(WwPlan *plan);
+
+/* Functions in ww-bulk.c */
+gboolean			ww_apply_layout_everywhere	(const gchar *layout_name,
+												 GError **error);
+
+/* Functions in ww-model.c */
+void				ww_model_init				(void);
+
+void				ww_model_refresh_when_idle	(void);
+
+WnckScreen*			ww_model_get_screen			(void);
+
+WwSnapshot*			ww_model_get_snapshot		(void);
+
+WnckWindow*			ww_model_get_active			(void);
+
+void				ww_model_set_predicted_active	(WnckWindow *window);
+
+WwSpatialIndex*		ww_model_get_spatial_index	(void);
+
+WnckWindow*			ww_model_get_neighbour		(WnckWindow *window,
+												 WwDirection direction);
+
+void				ww_model_log_neighbours		(void);
+
+/* Functions in ww-settle.c */
+void				ww_settle_reset				(void);
+
+void				ww_settle_expect			(WnckWindow *window,
+												 int x,
+												 int y,
+												 int width,
+												 int height);
+
+void				ww_settle_start				(const gchar *name);
+
+void				ww_settle_wait				(void);
+
+/* Functions in ww-dispatch.c */
+void				ww_dispatch_request			(const WwLayout *layout,
+												 guint32 event_time);
+
+void				ww_dispatch_request_full	(const WwLayout *layout,
+												 guint32 event_time,
+												 WwDispatchNotify notify,
+												 gpointer data);
+
+void				ww_activate_window			(WnckWindow *window);
+
+/* Functions in ww-arrangement.c */
+gboolean			ww_arrangement_save			(const gchar *path,
+												 GError **error);
+
+gboolean			ww_arrangement_restore		(const gchar *path,
+												 GError **error);
+
+gchar*				ww_arrangement_get_default_path	(void);
+
+/* Functions in ww-undo.c */
+void				ww_undo_record				(WwSnapshot *snapshot);
+
+void				ww_undo_push				(void);
+
+gboolean			ww_undo_pop					(WwPlan *plan);
+
+/* Functions in ww-ipc.c */
+gboolean			ww_ipc_listen				(GError **error);
+
+void				ww_ipc_shutdown				(void);
+
+gboolean			ww_ipc_forward_layout		(const gchar *layout_name,
+												 gboolean everywhere,
+												 gint64 *round_trip,
+												 GError **error);
+
+/* Functions in ww-workarea.c */
+void				ww_workarea_init			(WnckScreen *screen);
+
+void				ww_workarea_invalidate		(void);
+
+void				ww_workarea_get				(int workspace,
+												 int monitor,
+												 WwRect *workarea);
+
+/* Functions in ww-stats.c */
+gint64				ww_stats_now				(void);
+
+void				ww_stats_record				(const gchar *layout_name,
+												 WwPhase phase,
+												 gint64 start);
+
+void				ww_stats_count				(WwCounter counter,
+												 guint n);
+
+void				ww_stats_startup_begin		(void);
+
+void				ww_stats_startup_done		(const gchar *name);
+
+void				ww_stats_print				(void);
+
+void				ww_stats_log				(void);
+
 G_END_DECLS
 #endif /* _WW_H_ */
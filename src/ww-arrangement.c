@@ -0,0 +1,346 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An arrangement is the workspace and geometry of every window, saved to a
+ * file so it can be restored later, eg. after a retile or a crash.
+ *
+ * The file is a header followed by an array of fixed size records in host
+ * byte order. Strings are only stored as hashes, so restoring is a matter
+ * of mapping the file and pointing at the records. Windows are matched to
+ * records through a hash table on their class and role; the pid and title
+ * break ties between windows of the same application.
+ */
+
+#include <string.h>
+
+#include "winwrangler.h"
+
+#define WW_ARRANGEMENT_MAGIC "WWARR\0\0\0"
+#define WW_ARRANGEMENT_VERSION 1
+
+typedef struct
+{
+	gchar		magic[8];
+	guint32		version;
+	guint32		n_records;
+} WwArrangementHeader;
+
+typedef struct
+{
+	guint32		class_hash;
+	guint32		role_hash;
+	guint32		title_hash;
+	guint32		pid;
+	gint32		workspace;	/* WW_WORKSPACE_ALL if pinned */
+	gint32		x, y, width, height;
+} WwArrangementRecord;
+
+/* FNV-1a. Unlike g_str_hash() it is fixed, so files stay valid across
+ * GLib versions */
+static guint32
+hash_string (const gchar *str)
+{
+	guint32	hash;
+
+	hash = 2166136261u;
+	if (str)
+	{
+		for (; *str; str++)
+			hash = (hash ^ (guchar) *str) * 16777619u;
+	}
+
+	return hash;
+}
+
+/* Windows that make up an arrangement. Panels and such are left alone */
+static gboolean
+is_arranged (WnckWindow *win)
+{
+	return wnck_window_get_window_type (win) == WNCK_WINDOW_NORMAL &&
+		   !wnck_window_is_skip_tasklist (win);
+}
+
+static void
+describe_identity (WnckWindow *win, WwArrangementRecord *record)
+{
+	WnckClassGroup	*class_group;
+
+	class_group = wnck_window_get_class_group (win);
+	record->class_hash = hash_string (class_group ?
+						wnck_class_group_get_res_class (class_group) : NULL);
+	record->role_hash = hash_string (wnck_window_get_role (win));
+	record->title_hash = hash_string (wnck_window_get_name (win));
+	record->pid = wnck_window_get_pid (win);
+}
+
+/* The key of the hash index, the part of the identity that survives a
+ * restart of the application */
+static guint
+record_key (const WwArrangementRecord *record)
+{
+	return record->class_hash * 31 + record->role_hash;
+}
+
+/**
+ * ww_arrangement_save
+ * @path: The file to save to. Missing directories are created
+ * @error: Return location for a #GError or %NULL
+ *
+ * Save the workspace and geometry of every normal window on the default
+ * screen to @path. The file is replaced atomically.
+ *
+ * Return value: %FALSE if the file could not be written
+ */
+gboolean
+ww_arrangement_save (const gchar *path, GError **error)
+{
+	WwArrangementHeader	header;
+	WwArrangementRecord	record;
+	WnckWorkspace		*workspace;
+	WnckWindow			*win;
+	GByteArray			*data;
+	GList				*next;
+	gchar				*dir;
+	gboolean			result;
+
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	data = g_byte_array_new ();
+	memset (&header, 0, sizeof (header));
+	g_byte_array_append (data, (guint8 *) &header, sizeof (header));
+
+	for (next = wnck_screen_get_windows (ww_model_get_screen ());
+		 next; next = next->next)
+	{
+		win = WNCK_WINDOW (next->data);
+		if (!is_arranged (win))
+			continue;
+
+		memset (&record, 0, sizeof (record));
+		describe_identity (win, &record);
+
+		workspace = wnck_window_get_workspace (win);
+		record.workspace = workspace ? wnck_workspace_get_number (workspace)
+									 : WW_WORKSPACE_ALL;
+		wnck_window_get_geometry (win, &record.x, &record.y,
+								  &record.width, &record.height);
+
+		g_byte_array_append (data, (guint8 *) &record, sizeof (record));
+		header.n_records++;
+	}
+
+	memcpy (header.magic, WW_ARRANGEMENT_MAGIC, sizeof (header.magic));
+	header.version = WW_ARRANGEMENT_VERSION;
+	memcpy (data->data, &header, sizeof (header));
+
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	result = g_file_set_contents (path, (const gchar *) data->data,
+								  data->len, error);
+	if (result)
+		g_debug ("Saved %u windows to %s", header.n_records, path);
+	ww_stats_startup_done ("save");
+
+	g_byte_array_free (data, TRUE);
+
+	return result;
+}
+
+/* Find the best unused record for @win among the ones with the same key */
+static const WwArrangementRecord*
+match_record (GHashTable			*index,
+			  GHashTable			*used,
+			  WwArrangementRecord	*identity)
+{
+	const WwArrangementRecord	*record, *best;
+	GSList						*candidates;
+	int							score, best_score;
+
+	candidates = g_hash_table_lookup (index,
+									  GUINT_TO_POINTER (record_key (identity)));
+
+	best = NULL;
+	best_score = -1;
+	for (; candidates; candidates = candidates->next)
+	{
+		record = candidates->data;
+		if (record->class_hash != identity->class_hash ||
+			record->role_hash != identity->role_hash ||
+			g_hash_table_lookup (used, record))
+			continue;
+
+		/* The title survives a restart, the pid doesn't */
+		score = (record->title_hash == identity->title_hash) * 2 +
+				(record->pid == identity->pid);
+		if (score > best_score)
+		{
+			best = record;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+static void
+restore_workspace (WnckScreen *screen, WnckWindow *win, int number)
+{
+	WnckWorkspace	*workspace;
+
+	if (number == WW_WORKSPACE_ALL)
+	{
+		if (!wnck_window_is_pinned (win))
+			wnck_window_pin (win);
+		return;
+	}
+
+	if (wnck_window_is_pinned (win))
+		wnck_window_unpin (win);
+
+	workspace = wnck_screen_get_workspace (screen, number);
+	if (workspace && workspace != wnck_window_get_workspace (win))
+		wnck_window_move_to_workspace (win, workspace);
+}
+
+/**
+ * ww_arrangement_restore
+ * @path: The file written by ww_arrangement_save()
+ * @error: Return location for a #GError or %NULL
+ *
+ * Move every window that can be matched to a window in the saved
+ * arrangement back to its saved workspace and geometry. All geometry
+ * changes are committed in one batch, or printed with --dry-run.
+ *
+ * Return value: %FALSE if the file could not be read
+ */
+gboolean
+ww_arrangement_restore (const gchar *path, GError **error)
+{
+	const WwArrangementHeader	*header;
+	const WwArrangementRecord	*records, *record;
+	WwArrangementRecord			identity;
+	WnckScreen					*screen;
+	WnckWindow					*win;
+	GMappedFile					*file;
+	GHashTable					*index, *used;
+	GSList						*candidates;
+	GList						*next;
+	WwPlan						*plan;
+	gsize						length;
+	guint32						i;
+	guint						key, matched;
+
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	file = g_mapped_file_new (path, FALSE, error);
+	if (file == NULL)
+		return FALSE;
+
+	length = g_mapped_file_get_length (file);
+	header = (const WwArrangementHeader *) g_mapped_file_get_contents (file);
+
+	if (length < sizeof (WwArrangementHeader) ||
+		memcmp (header->magic, WW_ARRANGEMENT_MAGIC, sizeof (header->magic)) ||
+		header->version != WW_ARRANGEMENT_VERSION ||
+		length != sizeof (WwArrangementHeader) +
+				  (gsize) header->n_records * sizeof (WwArrangementRecord))
+	{
+		g_set_error (error, WW_ERROR, WW_ERROR_BAD_FORMAT,
+					 "%s is not a saved window arrangement", path);
+		g_mapped_file_unref (file);
+		return FALSE;
+	}
+
+	records = (const WwArrangementRecord *) (header + 1);
+
+	/* Index the records by class and role */
+	index = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+								   (GDestroyNotify) g_slist_free);
+	for (i = 0; i < header->n_records; i++)
+	{
+		key = record_key (&records[i]);
+		candidates = g_hash_table_lookup (index, GUINT_TO_POINTER (key));
+		if (candidates)
+			candidates->next = g_slist_prepend (candidates->next,
+												(gpointer) &records[i]);
+		else
+			g_hash_table_insert (index, GUINT_TO_POINTER (key),
+								 g_slist_prepend (NULL, (gpointer) &records[i]));
+	}
+
+	used = g_hash_table_new (g_direct_hash, g_direct_equal);
+	screen = ww_model_get_screen ();
+	plan = ww_plan_new ();
+	matched = 0;
+
+	for (next = wnck_screen_get_windows (screen); next; next = next->next)
+	{
+		win = WNCK_WINDOW (next->data);
+		if (!is_arranged (win))
+			continue;
+
+		describe_identity (win, &identity);
+		record = match_record (index, used, &identity);
+		if (record == NULL)
+			continue;
+
+		g_hash_table_insert (used, (gpointer) record, (gpointer) record);
+		matched++;
+
+		if (!ww_get_dry_run ())
+			restore_workspace (screen, win, record->workspace);
+
+		ww_plan_set_geometry (plan, win, record->x, record->y,
+							  record->width, record->height);
+	}
+
+	g_debug ("Matched %u of %u saved windows", matched, header->n_records);
+
+	if (ww_get_dry_run ())
+		ww_plan_print (plan);
+	else
+	{
+		ww_plan_commit (plan);
+		ww_settle_start ("restore");
+	}
+	ww_stats_startup_done ("restore");
+
+	ww_plan_free (plan);
+	g_hash_table_destroy (used);
+	g_hash_table_destroy (index);
+	g_mapped_file_unref (file);
+
+	return TRUE;
+}
+
+/**
+ * ww_arrangement_get_default_path
+ *
+ * Return value: The file arrangements are saved to by default. Free with
+ *               g_free()
+ */
+gchar*
+ww_arrangement_get_default_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "winwrangler",
+							 "arrangement", NULL);
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Startup benchmark for winwrangler. Run with 'make bench-startup'.
+#
+# Unlike ww-bench this needs a running X server and window manager, and it
+# moves windows around. The arrangement is saved first and restored last.
+#
+# Every mode is started RUNS times. Each run prints one line like
+#
+#   bench=startup mode=layout run=0 startup_us=8423 wall_us=15210
+#
+# where startup_us is the time from main() until the first geometry change
+# was sent (see ww_stats_startup_done()), and wall_us the time until the
+# process exited, including the dynamic linker. If a daemon is running the
+# layout modes are forwarded to it and show up as mode=forward.
+
+WINWRANGLER=${1:-./winwrangler}
+RUNS=${RUNS:-10}
+
+ARRANGEMENT=$(mktemp "${TMPDIR:-/tmp}/ww-bench-startup.XXXXXX")
+trap 'rm -f "$ARRANGEMENT"' EXIT
+
+now_ns ()
+{
+	date +%s%N
+}
+
+run_mode ()
+{
+	mode=$1
+	shift
+
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		start=$(now_ns)
+		out=$("$WINWRANGLER" --stats "$@" 2>/dev/null)
+		end=$(now_ns)
+
+		startup=$(echo "$out" | awk '$2 == "startup" { print $4 }')
+		case "$out" in
+			*"applied by the daemon"*) name=forward ;;
+			*) name=$mode ;;
+		esac
+
+		echo "bench=startup mode=$name run=$i startup_us=${startup:-none}" \
+			 "wall_us=$(( (end - start) / 1000 ))"
+		i=$((i + 1))
+	done
+}
+
+run_mode save --save --arrangement "$ARRANGEMENT"
+run_mode layouts --layouts
+run_mode dry-run --layout tile --dry-run
+run_mode layout --layout tile
+run_mode restore --restore --arrangement "$ARRANGEMENT"
@@ -0,0 +1,362 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A stand-in window manager for the Xvfb benchmark, see ww-bench-xvfb.sh.
+ *
+ * It implements just enough of the EWMH for libwnck and winwrangler: the
+ * client list, the active window, a single desktop with its workarea, and
+ * the _NET_MOVERESIZE_WINDOW message. Windows are not reparented or
+ * decorated, so every geometry request is granted as is and the time until
+ * it shows up is the cost of winwrangler and the X server alone.
+ *
+ * The number of geometry requests handled is published on the root window
+ * in the _WW_BENCH_WM_COUNTERS property, as two CARDINALs: ConfigureRequest
+ * events and _NET_MOVERESIZE_WINDOW messages. It is updated whenever the
+ * event queue runs empty.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+/* The top bits of _NET_MOVERESIZE_WINDOW's first argument */
+#define MOVERESIZE_X		(1 << 8)
+#define MOVERESIZE_Y		(1 << 9)
+#define MOVERESIZE_WIDTH	(1 << 10)
+#define MOVERESIZE_HEIGHT	(1 << 11)
+
+enum
+{
+	NET_SUPPORTED,
+	NET_SUPPORTING_WM_CHECK,
+	NET_WM_NAME,
+	NET_CLIENT_LIST,
+	NET_CLIENT_LIST_STACKING,
+	NET_ACTIVE_WINDOW,
+	NET_NUMBER_OF_DESKTOPS,
+	NET_CURRENT_DESKTOP,
+	NET_DESKTOP_GEOMETRY,
+	NET_DESKTOP_VIEWPORT,
+	NET_WORKAREA,
+	NET_WM_DESKTOP,
+	NET_FRAME_EXTENTS,
+	NET_MOVERESIZE_WINDOW,
+	UTF8_STRING,
+	WM_STATE,
+	WW_BENCH_WM_COUNTERS,
+	N_ATOMS
+};
+
+static char *atom_names[N_ATOMS] = {
+	"_NET_SUPPORTED",
+	"_NET_SUPPORTING_WM_CHECK",
+	"_NET_WM_NAME",
+	"_NET_CLIENT_LIST",
+	"_NET_CLIENT_LIST_STACKING",
+	"_NET_ACTIVE_WINDOW",
+	"_NET_NUMBER_OF_DESKTOPS",
+	"_NET_CURRENT_DESKTOP",
+	"_NET_DESKTOP_GEOMETRY",
+	"_NET_DESKTOP_VIEWPORT",
+	"_NET_WORKAREA",
+	"_NET_WM_DESKTOP",
+	"_NET_FRAME_EXTENTS",
+	"_NET_MOVERESIZE_WINDOW",
+	"UTF8_STRING",
+	"WM_STATE",
+	"_WW_BENCH_WM_COUNTERS"
+};
+
+static Display	*dpy;
+static Window	root;
+static Atom		atoms[N_ATOMS];
+static GArray	*clients;			/* of Window, in mapping order */
+static gulong	n_configure_requests = 0;
+static gulong	n_moveresize_messages = 0;
+static gboolean	counters_dirty = TRUE;
+static gboolean	other_wm = FALSE;
+
+static int
+on_x_error (Display *display, XErrorEvent *error)
+{
+	/* Clients vanish at any time, only care about the redirect */
+	if (error->request_code == 2 /* X_ChangeWindowAttributes */ &&
+		error->error_code == BadAccess)
+		other_wm = TRUE;
+
+	return 0;
+}
+
+static void
+set_cardinals (Window window, Atom property, long *values, int n)
+{
+	XChangeProperty (dpy, window, property, XA_CARDINAL, 32,
+					 PropModeReplace, (unsigned char *) values, n);
+}
+
+static void
+set_window (Window window, Atom property, Window value)
+{
+	XChangeProperty (dpy, window, property, XA_WINDOW, 32,
+					 PropModeReplace, (unsigned char *) &value, 1);
+}
+
+static void
+publish_clients (void)
+{
+	XChangeProperty (dpy, root, atoms[NET_CLIENT_LIST], XA_WINDOW, 32,
+					 PropModeReplace, (unsigned char *) clients->data,
+					 clients->len);
+	XChangeProperty (dpy, root, atoms[NET_CLIENT_LIST_STACKING], XA_WINDOW,
+					 32, PropModeReplace, (unsigned char *) clients->data,
+					 clients->len);
+}
+
+static void
+publish_counters (void)
+{
+	long	values[2];
+
+	values[0] = n_configure_requests;
+	values[1] = n_moveresize_messages;
+	set_cardinals (root, atoms[WW_BENCH_WM_COUNTERS], values, 2);
+	counters_dirty = FALSE;
+}
+
+static void
+activate (Window window)
+{
+	set_window (root, atoms[NET_ACTIVE_WINDOW], window);
+	XRaiseWindow (dpy, window);
+	XSetInputFocus (dpy, window, RevertToPointerRoot, CurrentTime);
+}
+
+static gboolean
+find_client (Window window, guint *index)
+{
+	guint	i;
+
+	for (i = 0; i < clients->len; i++)
+	{
+		if (g_array_index (clients, Window, i) == window)
+		{
+			*index = i;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+manage (Window window)
+{
+	long	state[2] = { NormalState, None };
+	long	extents[4] = { 0, 0, 0, 0 };
+	long	desktop = 0;
+	guint	index;
+
+	if (!find_client (window, &index))
+	{
+		XSelectInput (dpy, window, StructureNotifyMask);
+		g_array_append_val (clients, window);
+		publish_clients ();
+	}
+
+	XChangeProperty (dpy, window, atoms[WM_STATE], atoms[WM_STATE], 32,
+					 PropModeReplace, (unsigned char *) state, 2);
+	set_cardinals (window, atoms[NET_WM_DESKTOP], &desktop, 1);
+	set_cardinals (window, atoms[NET_FRAME_EXTENTS], extents, 4);
+
+	XMapWindow (dpy, window);
+	activate (window);
+}
+
+static void
+unmanage (Window window)
+{
+	guint	index;
+
+	if (!find_client (window, &index))
+		return;
+
+	g_array_remove_index (clients, index);
+	publish_clients ();
+}
+
+static void
+on_configure_request (XConfigureRequestEvent *event)
+{
+	XWindowChanges	changes;
+
+	changes.x = event->x;
+	changes.y = event->y;
+	changes.width = event->width;
+	changes.height = event->height;
+	changes.border_width = event->border_width;
+	changes.sibling = event->above;
+	changes.stack_mode = event->detail;
+	XConfigureWindow (dpy, event->window, event->value_mask, &changes);
+
+	n_configure_requests++;
+	counters_dirty = TRUE;
+}
+
+static void
+on_moveresize (XClientMessageEvent *event)
+{
+	XWindowChanges	changes;
+	unsigned int	mask;
+	long			flags;
+
+	flags = event->data.l[0];
+	mask = 0;
+	if (flags & MOVERESIZE_X) { changes.x = event->data.l[1]; mask |= CWX; }
+	if (flags & MOVERESIZE_Y) { changes.y = event->data.l[2]; mask |= CWY; }
+	if (flags & MOVERESIZE_WIDTH)
+	{
+		changes.width = MAX (event->data.l[3], 1);
+		mask |= CWWidth;
+	}
+	if (flags & MOVERESIZE_HEIGHT)
+	{
+		changes.height = MAX (event->data.l[4], 1);
+		mask |= CWHeight;
+	}
+
+	/* There are no frames, so every gravity means the same */
+	if (mask)
+		XConfigureWindow (dpy, event->window, mask, &changes);
+
+	n_moveresize_messages++;
+	counters_dirty = TRUE;
+}
+
+static void
+on_client_message (XClientMessageEvent *event)
+{
+	if (event->message_type == atoms[NET_MOVERESIZE_WINDOW])
+		on_moveresize (event);
+	else if (event->message_type == atoms[NET_ACTIVE_WINDOW])
+		activate (event->window);
+}
+
+static void
+setup_root (void)
+{
+	Window	check;
+	long	values[4];
+	int		width, height;
+
+	width = DisplayWidth (dpy, DefaultScreen (dpy));
+	height = DisplayHeight (dpy, DefaultScreen (dpy));
+
+	check = XCreateSimpleWindow (dpy, root, -1, -1, 1, 1, 0, 0, 0);
+	set_window (root, atoms[NET_SUPPORTING_WM_CHECK], check);
+	set_window (check, atoms[NET_SUPPORTING_WM_CHECK], check);
+	XChangeProperty (dpy, check, atoms[NET_WM_NAME], atoms[UTF8_STRING], 8,
+					 PropModeReplace, (unsigned char *) "ww-bench-wm",
+					 strlen ("ww-bench-wm"));
+
+	XChangeProperty (dpy, root, atoms[NET_SUPPORTED], XA_ATOM, 32,
+					 PropModeReplace, (unsigned char *) atoms,
+					 NET_MOVERESIZE_WINDOW + 1);
+
+	values[0] = 1;
+	set_cardinals (root, atoms[NET_NUMBER_OF_DESKTOPS], values, 1);
+	values[0] = 0;
+	set_cardinals (root, atoms[NET_CURRENT_DESKTOP], values, 1);
+	values[0] = width;
+	values[1] = height;
+	set_cardinals (root, atoms[NET_DESKTOP_GEOMETRY], values, 2);
+	values[0] = values[1] = 0;
+	set_cardinals (root, atoms[NET_DESKTOP_VIEWPORT], values, 2);
+	values[0] = values[1] = 0;
+	values[2] = width;
+	values[3] = height;
+	set_cardinals (root, atoms[NET_WORKAREA], values, 4);
+
+	publish_clients ();
+	publish_counters ();
+}
+
+int
+main (int argc, char *argv[])
+{
+	XEvent	event;
+
+	dpy = XOpenDisplay (NULL);
+	if (dpy == NULL)
+	{
+		g_printerr ("ww-bench-wm: Can not open display\n");
+		return 1;
+	}
+
+	root = DefaultRootWindow (dpy);
+	clients = g_array_new (FALSE, FALSE, sizeof (Window));
+
+	XSetErrorHandler (on_x_error);
+	XSelectInput (dpy, root, SubstructureRedirectMask | SubstructureNotifyMask);
+	XSync (dpy, False);
+	if (other_wm)
+	{
+		g_printerr ("ww-bench-wm: Another window manager is running\n");
+		return 1;
+	}
+
+	XInternAtoms (dpy, atom_names, N_ATOMS, False, atoms);
+	setup_root ();
+
+	for (;;)
+	{
+		if (counters_dirty && XPending (dpy) == 0)
+		{
+			publish_counters ();
+			XFlush (dpy);
+		}
+
+		XNextEvent (dpy, &event);
+		switch (event.type)
+		{
+			case MapRequest:
+				manage (event.xmaprequest.window);
+				break;
+			case ConfigureRequest:
+				on_configure_request (&event.xconfigurerequest);
+				break;
+			case ClientMessage:
+				on_client_message (&event.xclient);
+				break;
+			case UnmapNotify:
+				if (!event.xunmap.send_event)
+					unmanage (event.xunmap.window);
+				break;
+			case DestroyNotify:
+				unmanage (event.xdestroywindow.window);
+				break;
+		}
+	}
+
+	return 0;
+}
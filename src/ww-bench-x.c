@@ -0,0 +1,321 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * End to end benchmark of the layouts, run by ww-bench-xvfb.sh against a
+ * winwrangler daemon and ww-bench-wm on Xvfb.
+ *
+ * For every window count it maps that many dummy client windows, asks the
+ * daemon to apply each layout to them in turn over the socket of ww-ipc.c,
+ * and after each one waits until the clients have stopped receiving
+ * ConfigureNotify events. Results are printed like those of ww-bench, eg.
+ *
+ *   bench=xvfb layout=tile windows=50 round_trip_us=1830 settle_us=4210
+ *   configure_notifies=50 wm_requests=50
+ *
+ * round_trip_us is the time until the daemon answered, settle_us the time
+ * until the last ConfigureNotify, and wm_requests the number of geometry
+ * requests the window manager handled.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include "winwrangler.h"
+
+/* How long no ConfigureNotify must arrive for the windows to be settled */
+#define BENCH_X_QUIET_US 100000
+
+/* Give up waiting for the windows to settle after this long */
+#define BENCH_X_TIMEOUT_US 5000000
+
+/* How long the daemon gets to notice new windows */
+#define BENCH_X_MAP_DELAY_US 300000
+
+/* How long to wait for the daemon to start listening */
+#define BENCH_X_DAEMON_WAIT_US 10000000
+
+static gchar *window_counts = "1,10,50,100";
+static gchar *layout_names = "tile,twothirds,expand,undo";
+static gint runs = 3;
+
+static GOptionEntry option_entries[] = {
+	{ "windows", 'w', 0, G_OPTION_ARG_STRING, &window_counts,
+	  "Comma separated window counts", "N,..." },
+	{ "layouts", 'l', 0, G_OPTION_ARG_STRING, &layout_names,
+	  "Comma separated layouts to apply", "NAME,..." },
+	{ "runs", 'r', 0, G_OPTION_ARG_INT, &runs,
+	  "Measurements per layout and window count", "N" },
+	{ NULL }
+};
+
+static Atom	atom_counters;
+
+static int
+on_x_error (Display *display, XErrorEvent *error)
+{
+	return 0;
+}
+
+/* The sum of the counters published by ww-bench-wm */
+static gulong
+get_wm_requests (Display *dpy)
+{
+	Atom			type;
+	int				format;
+	unsigned long	n_items, remaining;
+	unsigned char	*data;
+	gulong			result;
+
+	data = NULL;
+	if (XGetWindowProperty (dpy, DefaultRootWindow (dpy), atom_counters,
+							0, 2, False, XA_CARDINAL, &type, &format,
+							&n_items, &remaining, &data) != Success ||
+		data == NULL)
+		return 0;
+
+	result = 0;
+	if (format == 32 && n_items == 2)
+		result = ((long *) data)[0] + ((long *) data)[1];
+	XFree (data);
+
+	return result;
+}
+
+static Window
+create_client (Display *dpy, int number, GRand *rand)
+{
+	XClassHint	class_hint;
+	Window		window;
+	gchar		*name;
+	int			width, height, x, y;
+
+	width = g_rand_int_range (rand, 200, 600);
+	height = g_rand_int_range (rand, 150, 450);
+	x = g_rand_int_range (rand, 0,
+						  MAX (DisplayWidth (dpy, 0) - width, 1));
+	y = g_rand_int_range (rand, 0,
+						  MAX (DisplayHeight (dpy, 0) - height, 1));
+
+	window = XCreateSimpleWindow (dpy, DefaultRootWindow (dpy),
+								  x, y, width, height, 0, 0, 0);
+
+	name = g_strdup_printf ("client %d", number);
+	XStoreName (dpy, window, name);
+	g_free (name);
+
+	class_hint.res_name = "ww-bench-client";
+	class_hint.res_class = "WwBenchClient";
+	XSetClassHint (dpy, window, &class_hint);
+
+	XSelectInput (dpy, window, StructureNotifyMask);
+	XMapWindow (dpy, window);
+
+	return window;
+}
+
+/* Process X events until no @event_type arrived for @quiet_us, or
+ * @timeout_us passed. Returns the number of @event_type events and the
+ * time of the last one */
+static guint
+wait_quiet (Display *dpy, gint64 quiet_us, gint64 timeout_us,
+			int event_type, gint64 *last)
+{
+	struct timeval	tv;
+	fd_set			fds;
+	XEvent			event;
+	gint64			start, now, wait;
+	guint			count;
+	int				fd;
+
+	fd = ConnectionNumber (dpy);
+	start = *last = g_get_monotonic_time ();
+	count = 0;
+
+	for (;;)
+	{
+		while (XPending (dpy))
+		{
+			XNextEvent (dpy, &event);
+			if (event.type == event_type)
+			{
+				count++;
+				*last = g_get_monotonic_time ();
+			}
+		}
+
+		now = g_get_monotonic_time ();
+		wait = MIN (*last + quiet_us, start + timeout_us) - now;
+		if (wait <= 0)
+			break;
+
+		FD_ZERO (&fds);
+		FD_SET (fd, &fds);
+		tv.tv_sec = wait / G_USEC_PER_SEC;
+		tv.tv_usec = wait % G_USEC_PER_SEC;
+		select (fd + 1, &fds, NULL, NULL, &tv);
+	}
+
+	return count;
+}
+
+/* Forward @layout_name, waiting for the daemon to come up if need be */
+static gboolean
+forward_layout (const gchar *layout_name, gint64 *round_trip)
+{
+	GError	*error;
+	gint64	deadline;
+
+	deadline = g_get_monotonic_time () + BENCH_X_DAEMON_WAIT_US;
+
+	error = NULL;
+	while (!ww_ipc_forward_layout (layout_name, FALSE, round_trip, &error))
+	{
+		if (g_get_monotonic_time () > deadline)
+		{
+			g_printerr ("No winwrangler daemon is running\n");
+			return FALSE;
+		}
+		g_usleep (100000);
+	}
+
+	if (error)
+	{
+		g_printerr ("Failed to apply %s: %s\n", layout_name, error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+bench_layout (Display *dpy, const gchar *layout_name, int n)
+{
+	gint64		start, last, round_trip;
+	gulong		requests;
+	guint		notifies;
+
+	requests = get_wm_requests (dpy);
+
+	start = g_get_monotonic_time ();
+	if (!forward_layout (layout_name, &round_trip))
+		return FALSE;
+
+	notifies = wait_quiet (dpy, BENCH_X_QUIET_US, BENCH_X_TIMEOUT_US,
+						   ConfigureNotify, &last);
+	if (notifies == 0)
+		last = start + round_trip;
+
+	g_print ("bench=xvfb layout=%s windows=%d round_trip_us=%"
+			 G_GINT64_FORMAT " settle_us=%" G_GINT64_FORMAT
+			 " configure_notifies=%u wm_requests=%lu\n",
+			 layout_name, n, round_trip, last - start, notifies,
+			 get_wm_requests (dpy) - requests);
+
+	return TRUE;
+}
+
+/* Map @n fresh clients and apply all layouts to them in turn, so undo has
+ * something to undo */
+static gboolean
+bench_windows (Display *dpy, gchar **layouts, int n, GRand *rand)
+{
+	Window		*windows;
+	gint64		last;
+	int			i;
+	gboolean	ok;
+
+	windows = g_new (Window, n);
+	for (i = 0; i < n; i++)
+		windows[i] = create_client (dpy, i, rand);
+
+	/* Let the windows map and the daemon pick them up */
+	XSync (dpy, False);
+	wait_quiet (dpy, BENCH_X_MAP_DELAY_US, BENCH_X_TIMEOUT_US,
+				MapNotify, &last);
+
+	ok = TRUE;
+	for (i = 0; layouts[i] && ok; i++)
+		ok = bench_layout (dpy, layouts[i], n);
+
+	for (i = 0; i < n; i++)
+		XDestroyWindow (dpy, windows[i]);
+	XSync (dpy, False);
+	g_free (windows);
+
+	return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext	*options;
+	GError			*error;
+	Display			*dpy;
+	GRand			*rand;
+	gchar			**counts, **names;
+	int				c, r;
+	gboolean		ok;
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+
+	options = g_option_context_new ("- end to end layout benchmark");
+	g_option_context_add_main_entries (options, option_entries, NULL);
+
+	error = NULL;
+	if (!g_option_context_parse (options, &argc, &argv, &error))
+	{
+		g_printerr ("Invalid command line: %s\n", error->message);
+		return 1;
+	}
+
+	dpy = XOpenDisplay (NULL);
+	if (dpy == NULL)
+	{
+		g_printerr ("Can not open display\n");
+		return 1;
+	}
+	XSetErrorHandler (on_x_error);
+	atom_counters = XInternAtom (dpy, "_WW_BENCH_WM_COUNTERS", False);
+
+	rand = g_rand_new_with_seed (42);
+	counts = g_strsplit (window_counts, ",", -1);
+	names = g_strsplit (layout_names, ",", -1);
+
+	ok = TRUE;
+	for (c = 0; counts[c] && ok; c++)
+		for (r = 0; r < runs && ok; r++)
+			ok = bench_windows (dpy, names, atoi (counts[c]), rand);
+
+	g_strfreev (names);
+	g_strfreev (counts);
+	g_rand_free (rand);
+	XCloseDisplay (dpy);
+	g_option_context_free (options);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# End to end layout benchmark. Run with 'make bench-xvfb'.
+#
+# Starts Xvfb with ww-bench-wm as the window manager and a winwrangler
+# daemon, then runs ww-bench-x, which maps dummy clients and times every
+# layout from the request to the last ConfigureNotify. Nothing runs on the
+# desktop of the user. Arguments are passed on to ww-bench-x, eg.
+#
+#   sh ww-bench-xvfb.sh --windows 10,100 --layouts tile,expand
+#
+# Set WW_BENCH_DISPLAY to use another display number than 99.
+
+BUILDDIR=$(dirname "$0")
+[ -x ./ww-bench-x ] && BUILDDIR=.
+
+DISPLAY_NUMBER=${WW_BENCH_DISPLAY:-99}
+SCREEN=${WW_BENCH_SCREEN:-1920x1080x24}
+
+if ! command -v Xvfb > /dev/null; then
+	echo "Xvfb is needed for the end to end benchmark" >&2
+	exit 1
+fi
+
+Xvfb ":$DISPLAY_NUMBER" -screen 0 "$SCREEN" -nolisten tcp > /dev/null 2>&1 &
+XVFB_PID=$!
+trap 'kill $DAEMON_PID $WM_PID $XVFB_PID 2> /dev/null' EXIT
+
+export DISPLAY=":$DISPLAY_NUMBER"
+
+# Wait for the server to create its socket
+i=0
+until [ -S "/tmp/.X11-unix/X$DISPLAY_NUMBER" ] || [ $i -ge 50 ]; do
+	sleep 0.1
+	i=$((i + 1))
+done
+
+"$BUILDDIR/ww-bench-wm" &
+WM_PID=$!
+sleep 0.2
+
+"$BUILDDIR/winwrangler" --daemon &
+DAEMON_PID=$!
+
+# ww-bench-x waits for the daemon to start listening
+"$BUILDDIR/ww-bench-x" "$@"
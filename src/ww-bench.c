@@ -0,0 +1,953 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks for the window layout code. Run with 'make bench'.
+ *
+ * Everything here works on synthetic windows, so no X server is needed.
+ * Results are printed one measurement per line as key=value pairs, eg.
+ *
+ *   bench=layout name=tile screen=1920x1080 struts=gnome windows=100 ...
+ *
+ * which is easy to grep, diff or load into a spreadsheet. The window counts
+ * go up in steps of ten, so each series of lines is a scaling curve.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "winwrangler.h"
+
+#define BENCH_SCREEN_W 1600
+#define BENCH_SCREEN_H 1200
+#define BENCH_MONITORS 3
+#define BENCH_QUERIES 2000
+#define BENCH_MAX_WINDOWS 10000
+#define BENCH_EXPAND_LAYOUTS 3000
+#define BENCH_GRAPH_MAX_WINDOWS 1000
+#define BENCH_GRAPH_MOVES 200
+
+/* A user defined layout, timed next to the built in ones */
+#define BENCH_PROGRAM \
+	"[Layout program]\n" \
+	"Split=columns (3: main, 2: rows (terms, other))\n" \
+	"Match-main=active\n" \
+	"Match-terms=class XTerm\n" \
+	"Match-other=any\n"
+
+/* Aim for roughly this many windows laid out per measurement */
+#define BENCH_WORK 200000
+
+typedef struct
+{
+	int			x, y;
+} BenchPoint;
+
+typedef struct
+{
+	const gchar	*name;
+	int			width, height;
+} BenchScreen;
+
+typedef struct
+{
+	const gchar	*name;
+	int			n_struts;
+	WwRect		struts[2];	/* relative to a 1000x1000 screen */
+} BenchStruts;
+
+static const BenchScreen bench_screens[] = {
+	{ "1024x768", 1024, 768 },
+	{ "1920x1080", 1920, 1080 },
+	{ "3840x2160", 3840, 2160 },
+};
+
+static const BenchStruts bench_struts[] = {
+	{ "none", 0 },
+	{ "top", 1, { { 0, 0, 1000, 24 } } },
+	{ "gnome", 2, { { 0, 0, 1000, 24 }, { 0, 976, 1000, 24 } } },
+	{ "left", 1, { { 0, 0, 48, 1000 } } },
+};
+
+/*
+ * Allocation counting. On GNU libc we wrap the allocator, which catches
+ * both our own and GLib's allocations. Elsewhere the count is reported as
+ * -1.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static volatile gulong n_allocs = 0;
+
+void *
+malloc (size_t size)
+{
+	n_allocs++;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	n_allocs++;
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	n_allocs++;
+	return __libc_realloc (ptr, size);
+}
+
+#define BENCH_HAVE_ALLOC_COUNT 1
+#define bench_alloc_count() (n_allocs)
+#else
+#define BENCH_HAVE_ALLOC_COUNT 0
+#define bench_alloc_count() (0)
+#endif
+
+static void
+ignore_log (const gchar		*domain,
+			GLogLevelFlags	level,
+			const gchar		*message,
+			gpointer		data)
+{
+}
+
+/* The scan ww_find_neighbour() used before the spatial index, kept here to
+ * compare against */
+static int
+linear_find_neighbour (BenchPoint *points, int n, int ax, int ay,
+					   WwDirection direction)
+{
+	double	wdist, ndist;
+	int		i, dx, dy, neighbour;
+
+	neighbour = -1;
+	ndist = 100000;
+
+	for (i = 0; i < n; i++)
+	{
+		dx = points[i].x - ax;
+		dy = points[i].y - ay;
+
+		if (direction == LEFT || direction == RIGHT)
+			wdist = sqrt (dx*dx + dy*dy*2);
+		else
+			wdist = sqrt (dx*dx*2 + dy*dy);
+
+		if ((direction == LEFT && points[i].x < ax) ||
+			(direction == RIGHT && points[i].x > ax) ||
+			(direction == UP && points[i].y < ay) ||
+			(direction == DOWN && points[i].y > ay))
+		{
+			if (wdist < ndist)
+			{
+				neighbour = i;
+				ndist = wdist;
+			}
+		}
+	}
+
+	return neighbour;
+}
+
+/* The expansion ww_engine_expand() did before it searched for the largest
+ * free rectangle, kept here to compare against. It starts from the full
+ * screen and shrinks each edge independently */
+static void
+heuristic_expand (const WwRect			*area,
+				  const WwWindowDesc	*windows,
+				  int					n_windows,
+				  const WwRect			*active,
+				  WwRect				*result)
+{
+	const WwRect	*w;
+	int				bx, by, br, bb;
+	int				i;
+
+	bx = area->x;
+	by = area->y;
+	br = area->x + area->width;
+	bb = area->y + area->height;
+
+	for (i = 0; i < n_windows; i++)
+	{
+		if (windows[i].flags & WW_WINDOW_ACTIVE)
+			continue;
+
+		w = &windows[i].geometry;
+
+		if (active->x > w->x + w->width)
+			bx = MAX (bx, w->x + w->width);
+		if (active->x + active->width < w->x)
+			br = MIN (br, w->x);
+		if (active->y > w->y + w->height)
+			by = MAX (by, w->y + w->height);
+		if (active->y + active->height < w->y)
+			bb = MIN (bb, w->y);
+	}
+
+	result->x = bx;
+	result->y = by;
+	result->width = br - bx;
+	result->height = bb - by;
+}
+
+static gboolean
+rects_overlap (const WwRect *a, const WwRect *b)
+{
+	return a->x < b->x + b->width && b->x < a->x + a->width &&
+		   a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+/* Whether @result stays in @bounds and only overlaps windows @active
+ * already overlapped */
+static gboolean
+expansion_is_valid (const WwRect		*bounds,
+					const WwWindowDesc	*windows,
+					int					n_windows,
+					const WwRect		*active,
+					const WwRect		*result)
+{
+	int	i;
+
+	if (result->x < bounds->x || result->y < bounds->y ||
+		result->x + result->width > bounds->x + bounds->width ||
+		result->y + result->height > bounds->y + bounds->height)
+		return FALSE;
+
+	for (i = 0; i < n_windows; i++)
+	{
+		if (windows[i].flags & WW_WINDOW_ACTIVE)
+			continue;
+		if (rects_overlap (&windows[i].geometry, result) &&
+			!rects_overlap (&windows[i].geometry, active))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Scale a strut given relative to a 1000x1000 screen */
+static void
+scale_rect (const WwRect *rel, const BenchScreen *screen, WwRect *rect)
+{
+	rect->x = rel->x * screen->width / 1000;
+	rect->y = rel->y * screen->height / 1000;
+	rect->width = rel->width * screen->width / 1000;
+	rect->height = rel->height * screen->height / 1000;
+
+	/* Keep struts flush with the screen edges after rounding */
+	if (rel->x + rel->width == 1000)
+		rect->width = screen->width - rect->x;
+	if (rel->y + rel->height == 1000)
+		rect->height = screen->height - rect->y;
+}
+
+/* Expand a random window in BENCH_EXPAND_LAYOUTS random layouts with both
+ * the old heuristic and the free rectangle search. The heuristic is given
+ * the full screen, as it used to be. Returns FALSE if the search ever
+ * returned an overlapping rectangle */
+static gboolean
+bench_expand_compare (int n, GRand *rand)
+{
+	const BenchScreen	*screen;
+	const BenchStruts	*struts;
+	WwWindowDesc		windows[50];
+	WwRect				screen_rect, bounds, active, result;
+	WwRect				strut_rects[2];
+	GTimer				*timer;
+	double				heur_ns, exact_ns, heur_cover, exact_cover, area;
+	int					heur_invalid, exact_invalid, layout, i, a;
+
+	g_return_val_if_fail (n <= 50, FALSE);
+
+	screen = &bench_screens[1];
+	struts = &bench_struts[2];
+	timer = g_timer_new ();
+
+	screen_rect.x = screen_rect.y = 0;
+	screen_rect.width = screen->width;
+	screen_rect.height = screen->height;
+	for (i = 0; i < struts->n_struts; i++)
+		scale_rect (&struts->struts[i], screen, &strut_rects[i]);
+	ww_engine_calc_bounds (&screen_rect, strut_rects, struts->n_struts,
+						   &bounds);
+	area = (double) bounds.width * bounds.height;
+
+	heur_ns = exact_ns = heur_cover = exact_cover = 0;
+	heur_invalid = exact_invalid = 0;
+
+	for (layout = 0; layout < BENCH_EXPAND_LAYOUTS; layout++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			memset (&windows[i], 0, sizeof (WwWindowDesc));
+			windows[i].geometry.width = g_rand_int_range (rand,
+										bounds.width / 10, bounds.width / 3);
+			windows[i].geometry.height = g_rand_int_range (rand,
+										bounds.height / 10, bounds.height / 3);
+			windows[i].geometry.x = bounds.x + g_rand_int_range (rand, 0,
+								bounds.width - windows[i].geometry.width);
+			windows[i].geometry.y = bounds.y + g_rand_int_range (rand, 0,
+								bounds.height - windows[i].geometry.height);
+		}
+
+		a = g_rand_int_range (rand, 0, n);
+		windows[a].flags |= WW_WINDOW_ACTIVE;
+		active = windows[a].geometry;
+
+		g_timer_start (timer);
+		heuristic_expand (&screen_rect, windows, n, &active, &result);
+		heur_ns += g_timer_elapsed (timer, NULL) * 1e9;
+		heur_cover += result.width * (double) result.height / area;
+		if (!expansion_is_valid (&bounds, windows, n, &active, &result))
+			heur_invalid++;
+
+		g_timer_start (timer);
+		ww_engine_expand (&bounds, windows, n, &active, &result);
+		exact_ns += g_timer_elapsed (timer, NULL) * 1e9;
+		exact_cover += result.width * (double) result.height / area;
+		if (!expansion_is_valid (&bounds, windows, n, &active, &result))
+			exact_invalid++;
+	}
+
+	g_print ("bench=expand-compare screen=%s struts=%s windows=%d layouts=%d "
+			 "heuristic_ns=%.0f heuristic_cover=%.3f heuristic_invalid=%d "
+			 "exact_ns=%.0f exact_cover=%.3f exact_invalid=%d\n",
+			 screen->name, struts->name, n, BENCH_EXPAND_LAYOUTS,
+			 heur_ns / BENCH_EXPAND_LAYOUTS,
+			 heur_cover / BENCH_EXPAND_LAYOUTS, heur_invalid,
+			 exact_ns / BENCH_EXPAND_LAYOUTS,
+			 exact_cover / BENCH_EXPAND_LAYOUTS, exact_invalid);
+
+	g_timer_destroy (timer);
+
+	return exact_invalid == 0;
+}
+
+/* Time neighbour lookups in the spatial index against a linear search and
+ * check they agree. Returns FALSE on any mismatch */
+static gboolean
+bench_spatial (int n, GRand *rand)
+{
+	WwSpatialIndex	*index;
+	BenchPoint		*points;
+	GTimer			*timer;
+	int				*queries;
+	double			linear_ns, index_ns, build_us;
+	int				i, q, expected, found, mismatches;
+	volatile int	sink;
+
+	points = g_new (BenchPoint, n);
+	queries = g_new (int, BENCH_QUERIES);
+	index = ww_spatial_index_new ();
+	timer = g_timer_new ();
+
+	for (i = 0; i < n; i++)
+	{
+		points[i].x = g_rand_int_range (rand, 0, BENCH_SCREEN_W);
+		points[i].y = g_rand_int_range (rand, 0, BENCH_SCREEN_H);
+	}
+
+	for (q = 0; q < BENCH_QUERIES; q++)
+		queries[q] = g_rand_int_range (rand, 0, n);
+
+	/* Linear scan */
+	sink = 0;
+	g_timer_start (timer);
+	for (q = 0; q < BENCH_QUERIES; q++)
+	{
+		i = queries[q];
+		sink += linear_find_neighbour (points, n, points[i].x, points[i].y,
+									   q % 4);
+	}
+	linear_ns = g_timer_elapsed (timer, NULL) * 1e9 / BENCH_QUERIES;
+
+	/* Index build, which happens lazily on the first lookup */
+	g_timer_start (timer);
+	for (i = 0; i < n; i++)
+		ww_spatial_index_add (index, points[i].x, points[i].y,
+							  GINT_TO_POINTER (i + 1));
+	ww_spatial_index_find_neighbour (index, 0, 0, RIGHT);
+	build_us = g_timer_elapsed (timer, NULL) * 1e6;
+
+	/* Index lookups */
+	g_timer_start (timer);
+	for (q = 0; q < BENCH_QUERIES; q++)
+	{
+		i = queries[q];
+		sink += GPOINTER_TO_INT (
+			ww_spatial_index_find_neighbour (index, points[i].x, points[i].y,
+											 q % 4));
+	}
+	index_ns = g_timer_elapsed (timer, NULL) * 1e9 / BENCH_QUERIES;
+
+	/* Both must agree on every answer */
+	mismatches = 0;
+	for (q = 0; q < BENCH_QUERIES; q++)
+	{
+		i = queries[q];
+		expected = linear_find_neighbour (points, n, points[i].x, points[i].y,
+										  q % 4);
+		found = GPOINTER_TO_INT (
+			ww_spatial_index_find_neighbour (index, points[i].x, points[i].y,
+											 q % 4)) - 1;
+		if (found != expected)
+			mismatches++;
+	}
+
+	g_print ("bench=neighbour windows=%d linear_ns=%.0f index_ns=%.0f "
+			 "build_us=%.1f mismatches=%d\n",
+			 n, linear_ns, index_ns, build_us, mismatches);
+
+	g_timer_destroy (timer);
+	ww_spatial_index_free (index);
+	g_free (queries);
+	g_free (points);
+
+	return mismatches == 0;
+}
+
+/* Keep a neighbour graph up to date while random windows move, and check
+ * it against the spatial index. Returns FALSE on any mismatch */
+static gboolean
+bench_graph (int n, GRand *rand)
+{
+	WwNeighbourGraph	*graph;
+	WwSpatialIndex		*index;
+	BenchPoint			*points;
+	GTimer				*timer;
+	gpointer			neighbour;
+	double				build_us, update_us, lookup_ns;
+	int					i, m, q, d, mismatches;
+	volatile gpointer	sink;
+
+	points = g_new (BenchPoint, n);
+	graph = ww_neighbour_graph_new ();
+	index = ww_spatial_index_new ();
+	timer = g_timer_new ();
+
+	for (i = 0; i < n; i++)
+	{
+		points[i].x = g_rand_int_range (rand, 0, BENCH_SCREEN_W);
+		points[i].y = g_rand_int_range (rand, 0, BENCH_SCREEN_H);
+	}
+
+	g_timer_start (timer);
+	for (i = 0; i < n; i++)
+		ww_neighbour_graph_set (graph, GINT_TO_POINTER (i + 1),
+								points[i].x, points[i].y);
+	build_us = g_timer_elapsed (timer, NULL) * 1e6;
+
+	/* Moving a window is what happens between two keypresses */
+	g_timer_start (timer);
+	for (m = 0; m < BENCH_GRAPH_MOVES; m++)
+	{
+		i = g_rand_int_range (rand, 0, n);
+		points[i].x = g_rand_int_range (rand, 0, BENCH_SCREEN_W);
+		points[i].y = g_rand_int_range (rand, 0, BENCH_SCREEN_H);
+		ww_neighbour_graph_set (graph, GINT_TO_POINTER (i + 1),
+								points[i].x, points[i].y);
+	}
+	update_us = g_timer_elapsed (timer, NULL) * 1e6 / BENCH_GRAPH_MOVES;
+
+	sink = NULL;
+	g_timer_start (timer);
+	for (q = 0; q < BENCH_QUERIES; q++)
+	{
+		ww_neighbour_graph_lookup (graph, GINT_TO_POINTER (q % n + 1),
+								   q % 4, &neighbour);
+		sink = neighbour;
+	}
+	lookup_ns = g_timer_elapsed (timer, NULL) * 1e9 / BENCH_QUERIES;
+
+	/* Points were added to both in the same order, so even ties agree */
+	for (i = 0; i < n; i++)
+		ww_spatial_index_add (index, points[i].x, points[i].y,
+							  GINT_TO_POINTER (i + 1));
+
+	mismatches = 0;
+	for (i = 0; i < n; i++)
+	{
+		for (d = LEFT; d <= DOWN; d++)
+		{
+			ww_neighbour_graph_lookup (graph, GINT_TO_POINTER (i + 1), d,
+									   &neighbour);
+			if (neighbour != ww_spatial_index_find_neighbour (index,
+										points[i].x, points[i].y, d))
+				mismatches++;
+		}
+	}
+
+	g_print ("bench=neighbour-graph windows=%d build_us=%.1f update_us=%.2f "
+			 "lookup_ns=%.0f mismatches=%d\n",
+			 n, build_us, update_us, lookup_ns, mismatches);
+
+	g_timer_destroy (timer);
+	ww_spatial_index_free (index);
+	ww_neighbour_graph_free (graph);
+	g_free (points);
+
+	return mismatches == 0;
+}
+
+static void
+bench_layout (const WwLayout		*layout,
+			  const BenchScreen		*screen,
+			  const BenchStruts		*struts,
+			  int					n,
+			  WwWindowDesc			*windows,
+			  WwRect				*cells,
+			  GRand					*rand)
+{
+	WwEngineInput	input;
+	WwRect			strut_rects[2];
+	GTimer			*timer;
+	gulong			allocs;
+	double			elapsed;
+	int				i, iterations;
+
+	for (i = 0; i < struts->n_struts; i++)
+		scale_rect (&struts->struts[i], screen, &strut_rects[i]);
+
+	for (i = 0; i < n; i++)
+	{
+		windows[i].geometry.width = g_rand_int_range (rand, 50, screen->width / 2);
+		windows[i].geometry.height = g_rand_int_range (rand, 50, screen->height / 2);
+		windows[i].geometry.x = g_rand_int_range (rand, 0,
+			screen->width - windows[i].geometry.width);
+		windows[i].geometry.y = g_rand_int_range (rand, 0,
+			screen->height - windows[i].geometry.height);
+		windows[i].flags = 0;
+		windows[i].min_width = 0;
+		windows[i].min_height = 0;
+		windows[i].base_width = 0;
+		windows[i].base_height = 0;
+		windows[i].width_inc = 0;
+		windows[i].height_inc = 0;
+		windows[i].class_hash = i % 2 ? g_str_hash ("XTerm") : 0;
+		windows[i].data = NULL;
+	}
+	windows[g_rand_int_range (rand, 0, n)].flags = WW_WINDOW_ACTIVE;
+
+	input.screen.x = 0;
+	input.screen.y = 0;
+	input.screen.width = screen->width;
+	input.screen.height = screen->height;
+	input.struts = strut_rects;
+	input.n_struts = struts->n_struts;
+	input.windows = windows;
+	input.n_windows = n;
+	input.data = layout->data;
+
+	/* winwrangler caches the workarea between layouts, so don't time it */
+	input.workarea.width = 0;
+	ww_engine_get_bounds (&input, &input.workarea);
+
+	iterations = MAX (BENCH_WORK / n, 10);
+
+	/* Warm up */
+	layout->compute (&input, cells);
+
+	timer = g_timer_new ();
+	allocs = bench_alloc_count ();
+	g_timer_start (timer);
+
+	for (i = 0; i < iterations; i++)
+		layout->compute (&input, cells);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	allocs = bench_alloc_count () - allocs;
+	g_timer_destroy (timer);
+
+	g_print ("bench=layout name=%s screen=%s struts=%s windows=%d "
+			 "ns_per_op=%.0f ns_per_window=%.1f allocs_per_op=%.2f\n",
+			 layout->name, screen->name, struts->name, n,
+			 elapsed * 1e9 / iterations,
+			 elapsed * 1e9 / iterations / n,
+			 BENCH_HAVE_ALLOC_COUNT ? (double) allocs / iterations : -1.0);
+}
+
+/*
+ * Classify n synthetic windows over and over into the same snapshot. Once
+ * the snapshot has grown to size this must not allocate at all, which is
+ * checked here.
+ *
+ * Return value: %FALSE if the steady state allocated
+ */
+static gboolean
+bench_classify (int n, GRand *rand)
+{
+	WwSnapshot		*snapshot;
+	WwWindowDesc	*windows;
+	WwMonitor		*monitor;
+	GTimer			*timer;
+	gulong			allocs;
+	double			elapsed;
+	int				i, j, iterations;
+
+	windows = g_new (WwWindowDesc, n);
+	snapshot = ww_snapshot_new ();
+
+	/* Side by side triple head, so classifying also assigns monitors */
+	g_array_set_size (snapshot->monitors, BENCH_MONITORS);
+	for (i = 0; i < BENCH_MONITORS; i++)
+	{
+		monitor = &g_array_index (snapshot->monitors, WwMonitor, i);
+		monitor->geometry.x = i * BENCH_SCREEN_W / BENCH_MONITORS;
+		monitor->geometry.y = 0;
+		monitor->geometry.width = BENCH_SCREEN_W / BENCH_MONITORS;
+		monitor->geometry.height = BENCH_SCREEN_H;
+		monitor->workarea = monitor->geometry;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		windows[i].geometry.x = g_rand_int_range (rand, 0, BENCH_SCREEN_W);
+		windows[i].geometry.y = g_rand_int_range (rand, 0, BENCH_SCREEN_H);
+		windows[i].geometry.width = g_rand_int_range (rand, 50, BENCH_SCREEN_W);
+		windows[i].geometry.height = g_rand_int_range (rand, 50, BENCH_SCREEN_H);
+		/* A mix of hidden, off-viewport and plain windows */
+		windows[i].flags = g_rand_int_range (rand, 0, 4) ? 0 :
+							1 << g_rand_int_range (rand, 1, 5);
+		if (g_rand_int_range (rand, 0, 4))
+			windows[i].flags |= WW_WINDOW_IN_VIEWPORT;
+		windows[i].type = g_rand_int_range (rand, 0, 20) == 0 ?
+							WW_WINDOW_TYPE_DOCK : WW_WINDOW_TYPE_NORMAL;
+		windows[i].workspace = g_rand_int_range (rand, WW_WORKSPACE_ALL, 4);
+		windows[i].min_width = 0;
+		windows[i].min_height = 0;
+		windows[i].base_width = 0;
+		windows[i].base_height = 0;
+		windows[i].width_inc = 0;
+		windows[i].height_inc = 0;
+		windows[i].class_hash = 0;
+		windows[i].data = NULL;
+	}
+
+	iterations = MAX (BENCH_WORK / n, 10);
+
+	/* Warm up, growing the snapshot to size */
+	for (i = 0; i < n; i++)
+		ww_snapshot_classify (snapshot, &windows[i], 0);
+
+	timer = g_timer_new ();
+	allocs = bench_alloc_count ();
+	g_timer_start (timer);
+
+	for (j = 0; j < iterations; j++)
+	{
+		ww_snapshot_reset (snapshot);
+		for (i = 0; i < n; i++)
+			ww_snapshot_classify (snapshot, &windows[i], 0);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	allocs = bench_alloc_count () - allocs;
+	g_timer_destroy (timer);
+
+	g_print ("bench=classify windows=%d monitors=%d user=%u struts=%u "
+			 "ns_per_op=%.0f ns_per_window=%.1f allocs_per_op=%.2f\n",
+			 n, BENCH_MONITORS, snapshot->windows->len, snapshot->struts->len,
+			 elapsed * 1e9 / iterations,
+			 elapsed * 1e9 / iterations / n,
+			 BENCH_HAVE_ALLOC_COUNT ? (double) allocs / iterations : -1.0);
+
+	ww_snapshot_free (snapshot);
+	g_free (windows);
+
+	return allocs == 0;
+}
+
+/*
+ * Compare the tiling solver to the square grid it replaced, on the screens
+ * above without struts. Both the time per call and the wasted fraction of
+ * the screen are reported. With @min_size every window asks for a quarter
+ * of the screen width, and the number of windows below it is reported too.
+ */
+static void
+bench_tile_compare (gboolean min_size)
+{
+	static const int	counts[] = { 2, 3, 5, 7, 10, 13, 20, 31, 50 };
+	const BenchScreen	*screen;
+	WwWindowDesc		windows[50];
+	WwRect				bounds, cells[50];
+	GTimer				*timer;
+	double				grid_ns, opt_ns, grid_waste, opt_waste;
+	guint				s, c;
+	int					i, n, iterations, small;
+
+	timer = g_timer_new ();
+
+	for (s = 0; s < G_N_ELEMENTS (bench_screens); s++)
+	{
+		screen = &bench_screens[s];
+		bounds.x = bounds.y = 0;
+		bounds.width = screen->width;
+		bounds.height = screen->height;
+
+		for (c = 0; c < G_N_ELEMENTS (counts); c++)
+		{
+			n = counts[c];
+			for (i = 0; i < n; i++)
+			{
+				memset (&windows[i], 0, sizeof (WwWindowDesc));
+				if (min_size)
+					windows[i].min_width = screen->width / 4;
+			}
+
+			iterations = 200;
+
+			g_timer_start (timer);
+			for (i = 0; i < iterations; i++)
+				ww_engine_tile (&bounds, n, cells);
+			grid_ns = g_timer_elapsed (timer, NULL) * 1e9 / iterations;
+			grid_waste = ww_engine_tile_waste (&bounds, cells, n);
+
+			g_timer_start (timer);
+			for (i = 0; i < iterations; i++)
+				ww_engine_tile_optimal (&bounds, windows, n,
+										WW_ENGINE_TILE_BUDGET, cells);
+			opt_ns = g_timer_elapsed (timer, NULL) * 1e9 / iterations;
+			opt_waste = ww_engine_tile_waste (&bounds, cells, n);
+
+			small = 0;
+			for (i = 0; i < n; i++)
+				if (cells[i].width < windows[i].min_width)
+					small++;
+
+			g_print ("bench=tile-compare screen=%s windows=%d min_size=%s "
+					 "grid_ns=%.0f grid_waste=%.3f "
+					 "optimal_ns=%.0f optimal_waste=%.3f optimal_too_small=%d\n",
+					 screen->name, n, min_size ? "quarter" : "none",
+					 grid_ns, grid_waste, opt_ns, opt_waste, small);
+		}
+	}
+
+	g_timer_destroy (timer);
+}
+
+/* Whether the window manager would grant @cell to @window as it is */
+static gboolean
+cell_accepted (const WwWindowDesc *window, const WwRect *cell)
+{
+	WwSizeHints	hints;
+
+	ww_engine_get_size_hints (window, FALSE, &hints);
+	if (ww_engine_fit_size (&hints, cell->width) != cell->width)
+		return FALSE;
+
+	ww_engine_get_size_hints (window, TRUE, &hints);
+	return ww_engine_fit_size (&hints, cell->height) == cell->height;
+}
+
+/*
+ * Lay out terminal-like windows, which only accept their base size plus a
+ * multiple of a character cell, with the square grid, the tiling solver and
+ * two-thirds. For each the number of cells the window manager would round
+ * is reported, along with the wasted fraction of the screen. Returns
+ * %FALSE if the solver or two-thirds produce a cell that would be rounded.
+ */
+static gboolean
+bench_hints (GRand *rand)
+{
+	static const int	counts[] = { 2, 3, 5, 7, 10, 13, 20, 31 };
+	const BenchScreen	*screen;
+	WwWindowDesc		windows[31];
+	WwRect				bounds, cells[31];
+	double				grid_waste, opt_waste, two_waste;
+	gboolean			ok;
+	guint				s, c;
+	int					i, n, grid_rounded, opt_rounded, two_rounded;
+
+	ok = TRUE;
+
+	for (s = 0; s < G_N_ELEMENTS (bench_screens); s++)
+	{
+		screen = &bench_screens[s];
+		bounds.x = bounds.y = 0;
+		bounds.width = screen->width;
+		bounds.height = screen->height;
+
+		for (c = 0; c < G_N_ELEMENTS (counts); c++)
+		{
+			n = counts[c];
+			for (i = 0; i < n; i++)
+			{
+				memset (&windows[i], 0, sizeof (WwWindowDesc));
+				windows[i].base_width = g_rand_int_range (rand, 10, 30);
+				windows[i].base_height = g_rand_int_range (rand, 10, 30);
+				windows[i].min_width = windows[i].base_width;
+				windows[i].min_height = windows[i].base_height;
+				windows[i].width_inc = g_rand_int_range (rand, 7, 20);
+				windows[i].height_inc = g_rand_int_range (rand, 7, 20);
+			}
+			windows[0].flags = WW_WINDOW_ACTIVE;
+
+			ww_engine_tile (&bounds, n, cells);
+			grid_waste = ww_engine_tile_waste (&bounds, cells, n);
+			grid_rounded = 0;
+			for (i = 0; i < n; i++)
+				if (!cell_accepted (&windows[i], &cells[i]))
+					grid_rounded++;
+
+			ww_engine_tile_optimal (&bounds, windows, n,
+									WW_ENGINE_TILE_BUDGET, cells);
+			opt_waste = ww_engine_tile_waste (&bounds, cells, n);
+			opt_rounded = 0;
+			for (i = 0; i < n; i++)
+				if (!cell_accepted (&windows[i], &cells[i]))
+					opt_rounded++;
+
+			ww_engine_twothirds (&bounds, windows, n, cells);
+			two_waste = ww_engine_tile_waste (&bounds, cells, n);
+			two_rounded = 0;
+			for (i = 0; i < n; i++)
+				if (!cell_accepted (&windows[i], &cells[i]))
+					two_rounded++;
+
+			g_print ("bench=tile-hints screen=%s windows=%d "
+					 "grid_rounded=%d grid_waste=%.3f "
+					 "optimal_rounded=%d optimal_waste=%.3f "
+					 "twothirds_rounded=%d twothirds_waste=%.3f\n",
+					 screen->name, n, grid_rounded, grid_waste,
+					 opt_rounded, opt_waste, two_rounded, two_waste);
+
+			if (opt_rounded > 0 || two_rounded > 0)
+				ok = FALSE;
+		}
+	}
+
+	return ok;
+}
+
+/* Compile BENCH_PROGRAM and register it like the layouts file would */
+static void
+register_program (void)
+{
+	static WwLayout	layout;
+	GKeyFile		*file;
+	GError			*error;
+
+	file = g_key_file_new ();
+	g_key_file_load_from_data (file, BENCH_PROGRAM, -1, G_KEY_FILE_NONE,
+							   NULL);
+
+	error = NULL;
+	layout.data = ww_program_compile (file, "Layout program", &error);
+	if (layout.data == NULL)
+	{
+		g_printerr ("Failed to compile the bench layout: %s\n",
+					error->message);
+		g_error_free (error);
+		g_key_file_free (file);
+		return;
+	}
+
+	layout.name = "program";
+	layout.label = "Program";
+	layout.desc = "A compiled user layout";
+	layout.compute = ww_engine_layout_program;
+	ww_register_layout (&layout);
+
+	g_key_file_free (file);
+}
+
+static void
+bench_layouts (GRand *rand)
+{
+	const WwLayout	*layout;
+	GList			*iter;
+	WwWindowDesc	*windows;
+	WwRect			*cells;
+	guint			s, t;
+	int				n;
+
+	windows = g_new (WwWindowDesc, BENCH_MAX_WINDOWS);
+	cells = g_new (WwRect, BENCH_MAX_WINDOWS);
+
+	register_program ();
+
+	for (iter = ww_get_layouts (); iter; iter = iter->next)
+	{
+		layout = iter->data;
+		
+		/* Layouts without a pure implementation need a live X server */
+		if (layout->compute == NULL)
+			continue;
+
+		for (s = 0; s < G_N_ELEMENTS (bench_screens); s++)
+			for (t = 0; t < G_N_ELEMENTS (bench_struts); t++)
+				for (n = 1; n <= BENCH_MAX_WINDOWS; n *= 10)
+					bench_layout (layout, &bench_screens[s], &bench_struts[t],
+								  n, windows, cells, rand);
+	}
+
+	g_free (cells);
+	g_free (windows);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GRand		*rand;
+	gboolean	ok;
+	int			n;
+
+	g_log_set_handler (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, ignore_log, NULL);
+
+	rand = g_rand_new_with_seed (42);
+
+	bench_layouts (rand);
+	bench_tile_compare (FALSE);
+	bench_tile_compare (TRUE);
+
+	ok = bench_hints (rand);
+	for (n = 5; n <= 40; n *= 2)
+		ok = bench_expand_compare (n, rand) && ok;
+
+	for (n = 10; n <= BENCH_MAX_WINDOWS; n *= 10)
+		ok = bench_classify (n, rand) && ok;
+
+	for (n = 10; n <= BENCH_MAX_WINDOWS; n *= 10)
+		ok = bench_spatial (n, rand) && ok;
+
+	for (n = 10; n <= BENCH_GRAPH_MAX_WINDOWS; n *= 10)
+		ok = bench_graph (n, rand) && ok;
+
+	g_rand_free (rand);
+
+	if (!ok)
+	{
+		g_printerr ("A tiling ignored the size increments of a window, "
+					"window classification allocated in the steady state, "
+					"an expansion overlapped a window, the spatial index "
+					"disagreed with a linear search, or the neighbour "
+					"graph disagreed with the spatial index\n");
+		return 1;
+	}
+
+	return 0;
+}
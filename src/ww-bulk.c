@@ -0,0 +1,378 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Applying a layout to all workspaces and viewports at once.
+ *
+ * The windows are read from libwnck in one pass and sorted into a snapshot
+ * per desktop, that is per viewport of each workspace, in the coordinates
+ * of that viewport. The snapshots are laid out on a pool of worker threads
+ * with the pure %WwEngineFunc of the layout, which only touches its own
+ * snapshot. The results are merged into a single plan, which is committed
+ * from the main thread like any other.
+ */
+
+#include <string.h>
+
+#include "winwrangler.h"
+
+/* Never start more workers than this */
+#define WW_BULK_MAX_WORKERS 8
+
+/* The viewports of a workspace */
+typedef struct
+{
+	int			first;		/* index of the top left viewport in desktops */
+	int			cols;
+	int			rows;
+	int			viewport_x;	/* the viewport shown on the workspace */
+	int			viewport_y;
+} WwBulkWorkspace;
+
+/* One viewport of one workspace */
+typedef struct
+{
+	int			workspace;
+	int			origin_x;	/* of the viewport within the workspace */
+	int			origin_y;
+	WwSnapshot	*snapshot;
+	WwRect		*cells;		/* one per window of snapshot */
+	gboolean	result;
+} WwDesktop;
+
+static WwDesktop*
+desktop_new (int workspace, int origin_x, int origin_y, WwSnapshot *current)
+{
+	WwDesktop	*desktop;
+	WwMonitor	*monitor;
+	guint		i;
+
+	desktop = g_new0 (WwDesktop, 1);
+	desktop->workspace = workspace;
+	desktop->origin_x = origin_x;
+	desktop->origin_y = origin_y;
+	desktop->snapshot = ww_snapshot_new ();
+
+	/* Every viewport has the monitors of the screen and the workarea of
+	 * its workspace */
+	desktop->snapshot->screen = current->screen;
+	ww_workarea_get (workspace, WW_MONITOR_ALL, &desktop->snapshot->workarea);
+	g_array_append_vals (desktop->snapshot->monitors,
+						 current->monitors->data, current->monitors->len);
+	for (i = 0; i < current->monitors->len; i++)
+	{
+		monitor = &g_array_index (desktop->snapshot->monitors, WwMonitor, i);
+		ww_workarea_get (workspace, i, &monitor->workarea);
+	}
+
+	return desktop;
+}
+
+static void
+desktop_free (WwDesktop *desktop)
+{
+	ww_snapshot_free (desktop->snapshot);
+	g_free (desktop->cells);
+	g_free (desktop);
+}
+
+/* Add a desktop for each viewport of each workspace */
+static GArray*
+collect_desktops (WnckScreen *screen, WwSnapshot *current, GPtrArray *desktops)
+{
+	WnckWorkspace	*workspace;
+	WwBulkWorkspace	*ws;
+	GArray			*workspaces;
+	int				n_workspaces, i, row, col;
+
+	n_workspaces = wnck_screen_get_workspace_count (screen);
+	workspaces = g_array_new (FALSE, TRUE, sizeof (WwBulkWorkspace));
+	g_array_set_size (workspaces, n_workspaces);
+
+	for (i = 0; i < n_workspaces; i++)
+	{
+		workspace = wnck_screen_get_workspace (screen, i);
+		ws = &g_array_index (workspaces, WwBulkWorkspace, i);
+		ws->first = desktops->len;
+		ws->cols = MAX (1, wnck_workspace_get_width (workspace) /
+						   MAX (current->screen.width, 1));
+		ws->rows = MAX (1, wnck_workspace_get_height (workspace) /
+						   MAX (current->screen.height, 1));
+		ws->viewport_x = wnck_workspace_get_viewport_x (workspace);
+		ws->viewport_y = wnck_workspace_get_viewport_y (workspace);
+
+		for (row = 0; row < ws->rows; row++)
+			for (col = 0; col < ws->cols; col++)
+				g_ptr_array_add (desktops,
+								 desktop_new (i, col * current->screen.width,
+											  row * current->screen.height,
+											  current));
+	}
+
+	return workspaces;
+}
+
+/* Put each window into the desktop of the viewport its centre is in */
+static void
+sort_windows (WnckScreen	*screen,
+			  WwSnapshot	*current,
+			  WnckWindow	*active,
+			  GArray		*workspaces,
+			  GPtrArray		*desktops)
+{
+	WnckWorkspace	*current_ws;
+	WwBulkWorkspace	*ws;
+	WwDesktop		*desktop;
+	WwWindowDesc	desc;
+	GList			*next;
+	int				number, x, y, col, row, width, height;
+
+	width = MAX (current->screen.width, 1);
+	height = MAX (current->screen.height, 1);
+	current_ws = wnck_screen_get_active_workspace (screen);
+
+	for (next = wnck_screen_get_windows (screen); next; next = next->next)
+	{
+		ww_describe_window (WNCK_WINDOW (next->data), NULL, &desc);
+
+		/* Windows on all workspaces are laid out where they are seen */
+		number = desc.workspace;
+		if (number == WW_WORKSPACE_ALL)
+			number = current_ws ? wnck_workspace_get_number (current_ws) : -1;
+		if (number < 0 || number >= (int) workspaces->len)
+			continue;
+
+		/* Geometries are relative to the viewport shown on the workspace */
+		ws = &g_array_index (workspaces, WwBulkWorkspace, number);
+		x = desc.geometry.x + ws->viewport_x + desc.geometry.width / 2;
+		y = desc.geometry.y + ws->viewport_y + desc.geometry.height / 2;
+		col = x < 0 ? 0 : MIN (x / width, ws->cols - 1);
+		row = y < 0 ? 0 : MIN (y / height, ws->rows - 1);
+		desktop = g_ptr_array_index (desktops, ws->first + row * ws->cols + col);
+
+		desc.geometry.x += ws->viewport_x - desktop->origin_x;
+		desc.geometry.y += ws->viewport_y - desktop->origin_y;
+		desc.flags |= WW_WINDOW_IN_VIEWPORT;
+
+		/* Follow the model in which window is active */
+		desc.flags &= ~WW_WINDOW_ACTIVE;
+		if (desc.data == active)
+			desc.flags |= WW_WINDOW_ACTIVE;
+
+		ww_snapshot_classify (desktop->snapshot, &desc, number);
+	}
+}
+
+/* Runs in a worker thread */
+static void
+run_desktop (gpointer data, gpointer user_data)
+{
+	WwDesktop		*desktop;
+	const WwLayout	*layout;
+
+	desktop = data;
+	layout = user_data;
+
+	desktop->result = ww_snapshot_run (desktop->snapshot, layout->compute,
+									   layout->data, desktop->cells);
+}
+
+static guint
+get_n_workers (guint n_desktops)
+{
+	guint	n_workers;
+
+#if GLIB_CHECK_VERSION (2, 36, 0)
+	n_workers = g_get_num_processors ();
+#else
+	n_workers = 2;
+#endif
+
+	n_workers = MIN (n_workers, MIN (n_desktops, WW_BULK_MAX_WORKERS));
+
+	return MAX (n_workers, 1);
+}
+
+/* Lay out all desktops, in parallel if there is more than one */
+static void
+run_desktops (const WwLayout *layout, GPtrArray *desktops)
+{
+	GThreadPool	*pool;
+	WwDesktop	*desktop;
+	guint		i, n_workers;
+
+	for (i = 0; i < desktops->len; i++)
+	{
+		desktop = g_ptr_array_index (desktops, i);
+		desktop->cells = g_new (WwRect, desktop->snapshot->windows->len);
+	}
+
+	/* The threads of a shared pool are kept around between calls */
+	pool = NULL;
+	n_workers = get_n_workers (desktops->len);
+	if (n_workers > 1)
+		pool = g_thread_pool_new (run_desktop, (gpointer) layout, n_workers,
+								  FALSE, NULL);
+
+	for (i = 0; i < desktops->len; i++)
+	{
+		if (pool)
+			g_thread_pool_push (pool, g_ptr_array_index (desktops, i), NULL);
+		else
+			run_desktop (g_ptr_array_index (desktops, i), (gpointer) layout);
+	}
+
+	/* Waits for all desktops to be done */
+	if (pool)
+		g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/* Add the windows the layout moved to @plan, in the coordinates libwnck
+ * uses, and their old geometry to @undo */
+static void
+merge_desktops (GArray		*workspaces,
+				GPtrArray	*desktops,
+				WwPlan		*plan,
+				WwSnapshot	*undo)
+{
+	WwBulkWorkspace	*ws;
+	WwDesktop		*desktop;
+	WwWindowDesc	*desc;
+	WwRect			*cell;
+	int				dx, dy;
+	guint			i, j;
+
+	for (i = 0; i < desktops->len; i++)
+	{
+		desktop = g_ptr_array_index (desktops, i);
+		if (!desktop->result)
+			continue;
+
+		ws = &g_array_index (workspaces, WwBulkWorkspace, desktop->workspace);
+		dx = desktop->origin_x - ws->viewport_x;
+		dy = desktop->origin_y - ws->viewport_y;
+
+		for (j = 0; j < desktop->snapshot->windows->len; j++)
+		{
+			desc = &g_array_index (desktop->snapshot->windows, WwWindowDesc, j);
+			cell = &desktop->cells[j];
+			if (memcmp (cell, &desc->geometry, sizeof (WwRect)) == 0)
+				continue;
+
+			ww_plan_set_geometry (plan, desc->data,
+								  cell->x + dx, cell->y + dy,
+								  cell->width, cell->height);
+
+			desc->geometry.x += dx;
+			desc->geometry.y += dy;
+			g_array_append_vals (undo->windows, desc, 1);
+		}
+	}
+}
+
+/**
+ * ww_apply_layout_everywhere
+ * @layout_name: The name of the layout to apply
+ * @error: Return location for a #GError or %NULL
+ *
+ * Apply a layout to every viewport of every workspace, not just the one
+ * shown. The desktops are laid out in parallel and all changes are sent
+ * to the X server together. Only layouts with a pure %WwEngineFunc can be
+ * applied like this.
+ *
+ * Return value: %FALSE if the layout is unknown or can't be applied to
+ *               all workspaces
+ */
+gboolean
+ww_apply_layout_everywhere (const gchar *layout_name, GError **error)
+{
+	const WwLayout	*layout;
+	WnckScreen		*screen;
+	WwSnapshot		*current, *undo;
+	GPtrArray		*desktops;
+	GArray			*workspaces;
+	WwPlan			*plan;
+	gchar			*stats_name;
+	gint64			start, phase_start;
+
+	start = ww_stats_now ();
+
+	layout = ww_get_layout (layout_name);
+	if (layout == NULL)
+	{
+		g_set_error (error, WW_ERROR, WW_ERROR_NO_SUCH_LAYOUT,
+					 "No such layout: '%s'", layout_name);
+		return FALSE;
+	}
+
+	if (layout->compute == NULL)
+	{
+		g_set_error (error, WW_ERROR, WW_ERROR_UNSUPPORTED,
+					 "Layout '%s' only works on the current workspace",
+					 layout_name);
+		return FALSE;
+	}
+
+	/* Samples of the whole screen don't belong with the others */
+	stats_name = g_strdup_printf ("%s@all", layout->name);
+
+	phase_start = ww_stats_now ();
+	screen = ww_model_get_screen ();
+	current = ww_model_get_snapshot ();
+	desktops = g_ptr_array_new_with_free_func ((GDestroyNotify) desktop_free);
+	workspaces = collect_desktops (screen, current, desktops);
+	sort_windows (screen, current, ww_model_get_active (), workspaces,
+				  desktops);
+	ww_stats_record (stats_name, WW_PHASE_REFRESH, phase_start);
+
+	phase_start = ww_stats_now ();
+	run_desktops (layout, desktops);
+	ww_stats_record (stats_name, WW_PHASE_COMPUTE, phase_start);
+
+	plan = ww_plan_new ();
+	undo = ww_snapshot_new ();
+	merge_desktops (workspaces, desktops, plan, undo);
+
+	g_debug ("Laid out %u desktops, %u windows to move",
+			 desktops->len, ww_plan_get_length (plan));
+
+	phase_start = ww_stats_now ();
+	if (ww_get_dry_run ())
+		ww_plan_print (plan);
+	else
+	{
+		if (!(layout->flags & WW_LAYOUT_NO_UNDO))
+			ww_undo_record (undo);
+		if (ww_plan_commit (plan) > 0 && !(layout->flags & WW_LAYOUT_NO_UNDO))
+			ww_undo_push ();
+		ww_settle_start (stats_name);
+	}
+	ww_stats_record (stats_name, WW_PHASE_COMMIT, phase_start);
+	ww_stats_startup_done (layout->name);
+
+	ww_plan_free (plan);
+	ww_snapshot_free (undo);
+	g_array_free (workspaces, TRUE);
+	g_ptr_array_free (desktops, TRUE);
+
+	ww_stats_record (stats_name, WW_PHASE_TOTAL, start);
+	g_free (stats_name);
+
+	return TRUE;
+}
@@ -0,0 +1,236 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The dispatcher applies the layouts requested by hotkeys at most once per
+ * frame, so a held or mashed hotkey doesn't make the window manager work
+ * through a storm of geometry changes. A request that arrives while no
+ * frame is open is applied right away and opens a frame. Requests that
+ * arrive during the frame are queued and applied when it ends, which opens
+ * the next frame. A frame that ends with an empty queue closes.
+ *
+ * A request for a %WW_LAYOUT_IDEMPOTENT layout is dropped if the same
+ * layout is already at the end of the queue. A %WW_LAYOUT_SUPERSEDES
+ * layout also drops the idempotent layouts queued right before it, since
+ * it places every window again anyway. Layouts switching windows are
+ * applied in order against the predicted active window (see
+ * ww_model_set_predicted_active()), and only the last window they activate
+ * with ww_activate_window() in a frame is actually activated.
+ */
+
+#include "winwrangler.h"
+
+/* How long to collect requests before applying them, in milliseconds */
+#define WW_DISPATCH_FRAME 16
+
+typedef struct
+{
+	const WwLayout		*layout;
+	guint32				event_time;
+	gint64				start;	/* ww_stats_now() of the first activation */
+	WwDispatchNotify	notify;	/* set if a client waits for the outcome */
+	gpointer			data;
+} WwRequest;
+
+static GArray		*dispatch_queue = NULL;	/* of WwRequest */
+static guint		dispatch_source = 0;
+static gboolean		dispatch_running = FALSE;
+static WnckWindow	*dispatch_activate = NULL;
+static guint32		dispatch_activate_time = 0;
+
+/* Apply @n_requests requests, sending only the last activation */
+static void
+dispatch_apply (const WwRequest *requests, guint n_requests)
+{
+	GError	*error;
+	guint	i;
+
+	dispatch_running = TRUE;
+
+	for (i = 0; i < n_requests; i++)
+	{
+		ww_set_event_time (requests[i].event_time);
+
+		error = NULL;
+		ww_apply_layout_by_name (requests[i].layout->name, &error);
+
+		if (requests[i].notify)
+			requests[i].notify (requests[i].layout, error, requests[i].data);
+		else if (error)
+			g_warning ("Failed to apply layout '%s': %s",
+					   requests[i].layout->name, error->message);
+
+		if (error)
+			g_error_free (error);
+
+		ww_stats_record (requests[i].layout->name, WW_PHASE_HOTKEY,
+						 requests[i].start);
+	}
+
+	dispatch_running = FALSE;
+
+	if (dispatch_activate)
+	{
+		wnck_window_activate (dispatch_activate, dispatch_activate_time);
+		ww_stats_count (WW_COUNTER_ACTIVATIONS, 1);
+		dispatch_activate = NULL;
+	}
+}
+
+static gboolean
+dispatch_frame (gpointer data)
+{
+	/* Nothing came in during the frame, the next request goes through
+	 * right away */
+	if (dispatch_queue->len == 0)
+	{
+		dispatch_source = 0;
+		return FALSE;
+	}
+
+	dispatch_apply ((WwRequest*) dispatch_queue->data, dispatch_queue->len);
+	g_array_set_size (dispatch_queue, 0);
+
+	return TRUE;
+}
+
+/**
+ * ww_dispatch_request
+ * @layout: The layout to apply
+ * @event_time: The time stamp of the event requesting the layout
+ *
+ * Apply @layout, right away if no frame is open and at the end of the
+ * current frame otherwise. If a queued request is a repeat of the last
+ * queued one and the layout is %WW_LAYOUT_IDEMPOTENT it is merged into it.
+ * If @layout is %WW_LAYOUT_SUPERSEDES the idempotent requests at the end
+ * of the queue are dropped, as @layout would overwrite what they do.
+ */
+void
+ww_dispatch_request (const WwLayout *layout, guint32 event_time)
+{
+	ww_dispatch_request_full (layout, event_time, NULL, NULL);
+}
+
+/**
+ * ww_dispatch_request_full
+ * @layout: The layout to apply
+ * @event_time: The time stamp of the event requesting the layout
+ * @notify: Function to call once @layout has been applied, or %NULL
+ * @data: User data for @notify
+ *
+ * Like ww_dispatch_request(), but @notify is called with the outcome once
+ * @layout has been applied, which may be before this returns. A request
+ * with a @notify is never merged into another one or dropped, since
+ * someone is waiting for that layout.
+ */
+void
+ww_dispatch_request_full (const WwLayout	*layout,
+						  guint32			event_time,
+						  WwDispatchNotify	notify,
+						  gpointer			data)
+{
+	WwRequest	request;
+	WwRequest	*last;
+
+	g_return_if_fail (layout != NULL);
+
+	if (dispatch_queue == NULL)
+		dispatch_queue = g_array_new (FALSE, FALSE, sizeof (WwRequest));
+
+	ww_stats_count (WW_COUNTER_REQUESTS, 1);
+
+	request.layout = layout;
+	request.event_time = event_time;
+	request.start = ww_stats_now ();
+	request.notify = notify;
+	request.data = data;
+
+	if (dispatch_source == 0)
+	{
+		dispatch_apply (&request, 1);
+		dispatch_source = g_timeout_add (WW_DISPATCH_FRAME,
+										 dispatch_frame, NULL);
+		return;
+	}
+
+	if (dispatch_queue->len > 0 && notify == NULL)
+	{
+		last = &g_array_index (dispatch_queue, WwRequest,
+							   dispatch_queue->len - 1);
+		if (last->layout == layout && (layout->flags & WW_LAYOUT_IDEMPOTENT))
+		{
+			g_debug ("Coalescing repeated request for '%s'", layout->name);
+			last->event_time = MAX (last->event_time, event_time);
+			ww_stats_count (WW_COUNTER_COALESCED, 1);
+			return;
+		}
+	}
+
+	/* Stop at the first layout that isn't idempotent, switching windows
+	 * for example depends on the geometries left by the layouts before */
+	while ((layout->flags & WW_LAYOUT_SUPERSEDES) && dispatch_queue->len > 0)
+	{
+		last = &g_array_index (dispatch_queue, WwRequest,
+							   dispatch_queue->len - 1);
+		if (!(last->layout->flags & WW_LAYOUT_IDEMPOTENT) || last->notify)
+			break;
+
+		g_debug ("Dropping request for '%s', superseded by '%s'",
+				 last->layout->name, layout->name);
+		request.start = MIN (request.start, last->start);
+		g_array_set_size (dispatch_queue, dispatch_queue->len - 1);
+		ww_stats_count (WW_COUNTER_COALESCED, 1);
+	}
+
+	g_array_append_val (dispatch_queue, request);
+}
+
+/**
+ * ww_activate_window
+ * @window: The window to activate
+ *
+ * Activate @window with the current event time. Layouts applied after this
+ * see @window as the active window right away. While the dispatcher is
+ * applying a frame the activation is held back, so only the last window
+ * activated in the frame is sent to the X server.
+ */
+void
+ww_activate_window (WnckWindow *window)
+{
+	g_return_if_fail (WNCK_IS_WINDOW (window));
+
+	ww_model_set_predicted_active (window);
+
+	if (!dispatch_running)
+	{
+		wnck_window_activate (window, ww_get_event_time ());
+		ww_stats_count (WW_COUNTER_ACTIVATIONS, 1);
+		return;
+	}
+
+	if (dispatch_activate)
+	{
+		g_debug ("Skipping activation of '%s'",
+				 wnck_window_get_name (dispatch_activate));
+		ww_stats_count (WW_COUNTER_FOCUS_COALESCED, 1);
+	}
+
+	dispatch_activate = window;
+	dispatch_activate_time = ww_get_event_time ();
+}
@@ -0,0 +1,1419 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *               Alessio 'molok' Bolognino <themolok@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ww-engine.h"
+
+#define is_high(w, h) (h > w)
+#define is_broad(w, h) (w > h)
+
+/**
+ * ww_engine_grid_size
+ * @count: The number of windows to be arranged
+ * @cols: Return location for the number of columns
+ * @rows: Return location for the number of rows
+ *
+ * Calculate a minimal grid containing @count windows
+ */
+void
+ww_engine_grid_size (int count, int *cols, int *rows)
+{
+	*cols = ceilf (sqrt (count));
+
+	/* Check if we have an exact square */
+	if ((*cols) * (*cols) == count)
+	{
+		*rows = *cols;
+		return;
+	}
+
+	*rows = floorf (sqrt (count));
+
+	/* Adjust for odd cases (like count=3) */
+	if ((*cols) * (*rows) < count)
+		(*rows)++;
+}
+
+/**
+ * ww_engine_calc_bounds
+ * @screen: The full screen area
+ * @struts: Geometries of the elements blocking the desktop, eg. panels
+ * @n_struts: The number of elements in @struts
+ * @bounds: Return location for the usable area
+ *
+ * Calculate the maximal rect within a set of blocking windows.
+ * For simplicity this method assumes that all struts are along the screen
+ * edges and expand over the entire screen edge. Ie a standard panel setup.
+ */
+void
+ww_engine_calc_bounds (const WwRect	*screen,
+					   const WwRect	*struts,
+					   int			n_struts,
+					   WwRect		*bounds)
+{
+	const WwRect	*s;
+	int				edge_l, edge_t, edge_b, edge_r;
+	int				screen_w, screen_h;
+	int				i;
+
+	edge_l = screen->x;
+	edge_t = screen->y;
+	edge_r = screen->x + screen->width;
+	edge_b = screen->y + screen->height;
+
+	screen_w = edge_r;
+	screen_h = edge_b;
+
+	for (i = 0; i < n_struts; i++)
+	{
+		s = &struts[i];
+
+		/* Left side strut */
+		if (is_high(s->width, s->height) && s->x == screen->x) {
+			edge_l = MAX(edge_l, s->x + s->width);
+		}
+
+		/* Top struct */
+		else if (is_broad(s->width, s->height) && s->y == screen->y) {
+			edge_t = MAX (edge_t, s->y + s->height);
+		}
+
+		/* Right side strut */
+		else if (is_high(s->width, s->height) &&
+				 (s->x + s->width) == screen_w) {
+			edge_r = MIN(edge_r, s->x);
+		}
+
+		/* Bottom struct */
+		else if (is_broad(s->width, s->height) &&
+				 (s->y + s->height) == screen_h) {
+			edge_b = MIN (edge_b, s->y);
+		}
+
+		else {
+			g_debug ("Ignoring floating element at (%d, %d)@%dx%d",
+					 s->x, s->y, s->width, s->height);
+		}
+	}
+
+	g_debug ("Calculated desktop bounds (%d, %d), (%d, %d)",
+			 edge_l, edge_t, edge_r, edge_b);
+
+	bounds->x = edge_l;
+	bounds->y = edge_t;
+	bounds->width = edge_r - edge_l;
+	bounds->height = edge_b - edge_t;
+}
+
+/* Whether the inclusive range [start, end] overlaps [lo, hi) */
+static inline gboolean
+span_overlaps (int start, int end, int lo, int hi)
+{
+	return start < hi && end >= lo;
+}
+
+/**
+ * ww_engine_calc_workarea
+ * @screen: The whole screen, which the struts are relative to
+ * @monitor: The part of @screen to calculate the usable area of
+ * @struts: The space reserved by panels and docks
+ * @n_struts: The number of elements in @struts
+ * @workarea: Return location for the usable part of @monitor
+ *
+ * Calculate the part of @monitor not covered by any strut. Unlike
+ * ww_engine_calc_bounds() this handles panels that only span part of a
+ * screen edge, and struts that don't touch @monitor are ignored.
+ */
+void
+ww_engine_calc_workarea (const WwRect	*screen,
+						 const WwRect	*monitor,
+						 const WwStrut	*struts,
+						 int			n_struts,
+						 WwRect			*workarea)
+{
+	const WwStrut	*s;
+	int				edge_l, edge_t, edge_r, edge_b;
+	int				mon_r, mon_b, scr_r, scr_b;
+	int				i;
+
+	edge_l = monitor->x;
+	edge_t = monitor->y;
+	edge_r = mon_r = monitor->x + monitor->width;
+	edge_b = mon_b = monitor->y + monitor->height;
+
+	scr_r = screen->x + screen->width;
+	scr_b = screen->y + screen->height;
+
+	for (i = 0; i < n_struts; i++)
+	{
+		s = &struts[i];
+
+		if (s->left > 0 &&
+			span_overlaps (s->left_start_y, s->left_end_y, monitor->y, mon_b))
+			edge_l = MAX (edge_l, screen->x + s->left);
+
+		if (s->right > 0 &&
+			span_overlaps (s->right_start_y, s->right_end_y, monitor->y, mon_b))
+			edge_r = MIN (edge_r, scr_r - s->right);
+
+		if (s->top > 0 &&
+			span_overlaps (s->top_start_x, s->top_end_x, monitor->x, mon_r))
+			edge_t = MAX (edge_t, screen->y + s->top);
+
+		if (s->bottom > 0 &&
+			span_overlaps (s->bottom_start_x, s->bottom_end_x, monitor->x, mon_r))
+			edge_b = MIN (edge_b, scr_b - s->bottom);
+	}
+
+	/* Struts covering the whole monitor are bogus, ignore them all */
+	if (edge_r <= edge_l || edge_b <= edge_t)
+	{
+		g_debug ("Struts cover the whole monitor, ignoring them");
+		*workarea = *monitor;
+		return;
+	}
+
+	workarea->x = edge_l;
+	workarea->y = edge_t;
+	workarea->width = edge_r - edge_l;
+	workarea->height = edge_b - edge_t;
+}
+
+/**
+ * ww_engine_get_bounds
+ * @input: The desktop to get the bounds of
+ * @bounds: Return location for the usable area
+ *
+ * Get the area layouts may use. This is the workarea of @input if it is
+ * known, otherwise it is guessed from the struts with
+ * ww_engine_calc_bounds().
+ */
+void
+ww_engine_get_bounds (const WwEngineInput *input, WwRect *bounds)
+{
+	if (input->workarea.width > 0 && input->workarea.height > 0)
+	{
+		*bounds = input->workarea;
+		return;
+	}
+
+	ww_engine_calc_bounds (&input->screen, input->struts, input->n_struts,
+						   bounds);
+}
+
+/**
+ * ww_engine_get_size_hints
+ * @window: The window to get the size hints of
+ * @vertical: %TRUE for the heights @window accepts, %FALSE for the widths
+ * @hints: Return location for the hints
+ *
+ * Collect the size hints of @window along one axis.
+ */
+void
+ww_engine_get_size_hints (const WwWindowDesc	*window,
+						  gboolean				vertical,
+						  WwSizeHints			*hints)
+{
+	hints->min = vertical ? window->min_height : window->min_width;
+	hints->base = vertical ? window->base_height : window->base_width;
+	hints->inc = vertical ? window->height_inc : window->width_inc;
+}
+
+/**
+ * ww_engine_fit_size
+ * @hints: The sizes a window accepts
+ * @size: The size the window should have
+ *
+ * Round @size down to a size the window manager will grant, so it doesn't
+ * round it itself. Sizes below the smallest accepted size are rounded up
+ * to it instead.
+ *
+ * Return value: The largest accepted size not above @size, if any
+ */
+int
+ww_engine_fit_size (const WwSizeHints *hints, int size)
+{
+	int	inc, least;
+
+	inc = MAX (hints->inc, 1);
+
+	least = hints->base;
+	if (least < hints->min)
+		least += (hints->min - hints->base + inc - 1) / inc * inc;
+
+	if (size <= least)
+		return least;
+
+	return hints->base + (size - hints->base) / inc * inc;
+}
+
+/**
+ * ww_engine_allocate
+ * @length: The length to split
+ * @hints: The sizes each window accepts along the split
+ * @n: The number of windows
+ * @starts: Return location for @n offsets from the start of @length
+ * @sizes: Return location for @n sizes
+ *
+ * Split @length into @n consecutive spans, as equal as the size hints of
+ * the windows allow. Each window gets the largest size it accepts within
+ * its share, and the pixels left over go to the windows that accept any
+ * size. If there are none they are handed out in whole increments to the
+ * windows furthest below their share, and what remains is spread as gaps
+ * between the windows. Without size hints this is an even split.
+ */
+void
+ww_engine_allocate (int					length,
+					const WwSizeHints	*hints,
+					int					n,
+					int					*starts,
+					int					*sizes)
+{
+	int		i, k, n_free, left, best, pos, share, deficit, best_deficit;
+
+	if (n == 0)
+		return;
+
+	left = length;
+	n_free = 0;
+	for (i = 0; i < n; i++)
+	{
+		share = (i + 1) * length / n - i * length / n;
+		sizes[i] = ww_engine_fit_size (&hints[i], share);
+		left -= sizes[i];
+		if (hints[i].inc <= 1)
+			n_free++;
+	}
+
+	/* Windows taking any size soak up what the others couldn't use */
+	if (left > 0 && n_free > 0)
+	{
+		for (i = 0, k = 0; i < n; i++)
+		{
+			if (hints[i].inc > 1)
+				continue;
+			sizes[i] += (k + 1) * left / n_free - k * left / n_free;
+			k++;
+		}
+		left = 0;
+	}
+
+	/* Each step takes at least two pixels, so this ends */
+	while (left > 0)
+	{
+		best = -1;
+		best_deficit = G_MININT;
+		for (i = 0; i < n; i++)
+		{
+			if (hints[i].inc > left)
+				continue;
+			deficit = (i + 1) * length / n - i * length / n - sizes[i];
+			if (deficit > best_deficit)
+			{
+				best = i;
+				best_deficit = deficit;
+			}
+		}
+		if (best < 0)
+			break;
+
+		sizes[best] += hints[best].inc;
+		left -= hints[best].inc;
+	}
+
+	/* Spread the rest between the windows, so the last one still ends at
+	 * @length. If the minimum sizes don't fit the windows overlap evenly */
+	pos = 0;
+	for (i = 0; i < n; i++)
+	{
+		starts[i] = pos + (n > 1 ? left * i / (n - 1) : 0);
+		pos += sizes[i];
+	}
+}
+
+/**
+ * ww_engine_tile
+ * @bounds: The area to tile
+ * @n_windows: The number of windows to tile
+ * @cells: Return location for @n_windows rectangles
+ *
+ * Tile @n_windows windows in a grid over @bounds, filling it row by row.
+ *
+ * Return value: %FALSE if there is nothing to tile
+ */
+gboolean
+ww_engine_tile (const WwRect	*bounds,
+				int				n_windows,
+				WwRect			*cells)
+{
+	int		cols, rows;
+	int		cell_w, cell_h;
+	int		row, col, i;
+
+	if (n_windows == 0)
+		return FALSE;
+
+	ww_engine_grid_size (n_windows, &cols, &rows);
+
+	cell_w = bounds->width / cols;
+	cell_h = bounds->height / rows;
+
+	g_debug ("Grid is %dx%d, with cell size %dx%d\n",
+			 cols, rows, cell_w, cell_h);
+
+	row = 0;
+	col = 0;
+	for (i = 0; i < n_windows; i++)
+	{
+		cells[i].x = col*cell_w + bounds->x;
+		cells[i].y = row*cell_h + bounds->y;
+		cells[i].width = cell_w;
+		cells[i].height = cell_h;
+
+		col++;
+
+		/* Check if we should start a new row */
+		if (col == cols)
+		{
+			col = 0;
+			row++;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The aspect ratio tiles are measured against. Area of a cell outside the
+ * largest rectangle of this shape that fits in it counts as wasted */
+#define TILE_ASPECT (4.0 / 3.0)
+
+/* How many windows more or less than the average a row may get */
+#define TILE_SLACK 2
+
+/* The cost of a pixel a window is short of its minimum size, relative to a
+ * wasted pixel */
+#define TILE_PENALTY 4.0
+
+/* Above this many windows the search is skipped in favour of the grid */
+#define TILE_MAX_WINDOWS 256
+
+static double
+cell_waste (double w, double h)
+{
+	double	fit_w;
+
+	fit_w = MIN (w, h * TILE_ASPECT);
+	return w * h - fit_w * fit_w / TILE_ASPECT;
+}
+
+/* The cost of putting @k windows from @first in a row of @k cells of
+ * @cw x @ch. If @transposed the row is really a column */
+static double
+row_cost (const WwWindowDesc	*windows,
+		  int					first,
+		  int					k,
+		  double				cw,
+		  double				ch,
+		  gboolean				transposed)
+{
+	const WwWindowDesc	*win;
+	double				violation;
+	int					i, mw, mh;
+
+	violation = 0;
+	for (i = first; i < first + k; i++)
+	{
+		win = &windows[i];
+		mw = transposed ? win->min_height : win->min_width;
+		mh = transposed ? win->min_width : win->min_height;
+		violation += MAX (0, mw - cw) * ch + MAX (0, mh - ch) * cw;
+	}
+
+	return k * (transposed ? cell_waste (ch, cw) : cell_waste (cw, ch))
+		   + TILE_PENALTY * violation;
+}
+
+/*
+ * Split @n windows into @n_rows rows of equal height over a @width x
+ * @height area, keeping the window order, so that the total cost is
+ * minimal. Each row holds close to n / n_rows windows. The cost of the
+ * last rows for each number of windows left is memoized, which makes this
+ * O(n * n_rows * TILE_SLACK) row costs.
+ *
+ * Returns the cost and writes the number of windows in each row to
+ * @counts, or returns -1 if the deadline passed.
+ */
+static double
+solve_rows (const WwWindowDesc	*windows,
+			int					n,
+			double				width,
+			double				height,
+			int					n_rows,
+			gboolean			transposed,
+			gint64				deadline,
+			int					*counts)
+{
+	double	*cost, c, ch;
+	int		*choice;
+	int		r, i, k, lo, hi;
+
+	lo = MAX (1, n / n_rows - TILE_SLACK);
+	hi = MIN (n, (n + n_rows - 1) / n_rows + TILE_SLACK);
+	ch = height / n_rows;
+
+	/* cost[r * (n + 1) + i]: the best cost of windows i..n-1 in r rows */
+	cost = g_new (double, (n_rows + 1) * (n + 1));
+	choice = g_new (int, (n_rows + 1) * (n + 1));
+
+	for (i = 0; i <= n; i++)
+		cost[i] = i == n ? 0 : G_MAXDOUBLE;
+
+	for (r = 1; r <= n_rows; r++)
+	{
+		if (g_get_monotonic_time () > deadline)
+		{
+			g_free (cost);
+			g_free (choice);
+			return -1;
+		}
+
+		for (i = 0; i <= n; i++)
+		{
+			cost[r * (n + 1) + i] = G_MAXDOUBLE;
+			for (k = lo; k <= hi && i + k <= n; k++)
+			{
+				if (cost[(r - 1) * (n + 1) + i + k] == G_MAXDOUBLE)
+					continue;
+
+				c = row_cost (windows, i, k, width / k, ch, transposed)
+					+ cost[(r - 1) * (n + 1) + i + k];
+				if (c < cost[r * (n + 1) + i])
+				{
+					cost[r * (n + 1) + i] = c;
+					choice[r * (n + 1) + i] = k;
+				}
+			}
+		}
+	}
+
+	c = cost[n_rows * (n + 1)];
+	if (c < G_MAXDOUBLE)
+	{
+		for (r = n_rows, i = 0; r > 0; r--)
+		{
+			counts[n_rows - r] = choice[r * (n + 1) + i];
+			i += counts[n_rows - r];
+		}
+	}
+
+	g_free (cost);
+	g_free (choice);
+
+	return c;
+}
+
+/* Lay out rows of windows with the given counts. If @transposed the rows
+ * are columns. The windows of a row share its length according to their
+ * size hints, and each is as high as it accepts within the row */
+static void
+place_rows (const WwRect		*bounds,
+			const WwWindowDesc	*windows,
+			const int			*counts,
+			int					n_rows,
+			gboolean			transposed,
+			WwRect				*cells)
+{
+	WwSizeHints	*hints, cross;
+	int			*starts, *sizes;
+	int			r, j, k, w, h, i, max_k;
+	int			a0, a, b0, b;
+
+	w = transposed ? bounds->height : bounds->width;
+	h = transposed ? bounds->width : bounds->height;
+
+	max_k = 0;
+	for (r = 0; r < n_rows; r++)
+		max_k = MAX (max_k, counts[r]);
+
+	hints = g_new (WwSizeHints, max_k);
+	starts = g_new (int, max_k);
+	sizes = g_new (int, max_k);
+
+	i = 0;
+	for (r = 0; r < n_rows; r++)
+	{
+		b0 = r * h / n_rows;
+		k = counts[r];
+
+		for (j = 0; j < k; j++)
+			ww_engine_get_size_hints (&windows[i + j], transposed, &hints[j]);
+		ww_engine_allocate (w, hints, k, starts, sizes);
+
+		for (j = 0; j < k; j++, i++)
+		{
+			a0 = starts[j];
+			a = sizes[j];
+			ww_engine_get_size_hints (&windows[i], !transposed, &cross);
+			b = ww_engine_fit_size (&cross, (r + 1) * h / n_rows - b0);
+
+			if (transposed)
+			{
+				cells[i].x = bounds->x + b0;
+				cells[i].y = bounds->y + a0;
+				cells[i].width = b;
+				cells[i].height = a;
+			}
+			else
+			{
+				cells[i].x = bounds->x + a0;
+				cells[i].y = bounds->y + b0;
+				cells[i].width = a;
+				cells[i].height = b;
+			}
+		}
+	}
+
+	g_free (hints);
+	g_free (starts);
+	g_free (sizes);
+}
+
+/* Shrink each cell to the largest size its window accepts */
+static void
+fit_cells (const WwWindowDesc *windows, int n_windows, WwRect *cells)
+{
+	WwSizeHints	hints;
+	int			i;
+
+	for (i = 0; i < n_windows; i++)
+	{
+		ww_engine_get_size_hints (&windows[i], FALSE, &hints);
+		cells[i].width = ww_engine_fit_size (&hints, cells[i].width);
+		ww_engine_get_size_hints (&windows[i], TRUE, &hints);
+		cells[i].height = ww_engine_fit_size (&hints, cells[i].height);
+	}
+}
+
+/**
+ * ww_engine_tile_optimal
+ * @bounds: The area to tile
+ * @windows: The windows to tile
+ * @n_windows: The number of elements in @windows
+ * @budget: The time the search may take, in microseconds
+ * @cells: Return location for @n_windows rectangles
+ *
+ * Tile the windows over @bounds in rows, or columns, where each row may
+ * hold a different number of windows. Unlike ww_engine_tile() this never
+ * leaves empty cells. The number of rows is searched for the layout that
+ * wastes the least area on cells of awkward shape and gives every window
+ * at least its minimum size where possible. Row counts close to the
+ * square grid are tried first, and the best layout found when @budget is
+ * used up is returned. The cells respect the size increments of the
+ * windows, see ww_engine_allocate().
+ *
+ * Return value: %FALSE if there is nothing to tile
+ */
+gboolean
+ww_engine_tile_optimal (const WwRect		*bounds,
+						const WwWindowDesc	*windows,
+						int					n_windows,
+						gint64				budget,
+						WwRect				*cells)
+{
+	gint64		deadline;
+	double		c, best;
+	int			*counts, *best_counts;
+	int			cols, rows, step, n_rows, best_rows, t;
+	gboolean	transposed, best_transposed;
+
+	if (n_windows == 0)
+		return FALSE;
+
+	if (n_windows > TILE_MAX_WINDOWS)
+	{
+		ww_engine_tile (bounds, n_windows, cells);
+		fit_cells (windows, n_windows, cells);
+		return TRUE;
+	}
+
+	deadline = g_get_monotonic_time () + budget;
+	ww_engine_grid_size (n_windows, &cols, &rows);
+
+	counts = g_new (int, n_windows);
+	best_counts = g_new (int, n_windows);
+	best = G_MAXDOUBLE;
+	best_rows = 0;
+	best_transposed = FALSE;
+
+	/* Start at the square grid and work outwards */
+	for (step = 0; step < 2 * n_windows; step++)
+	{
+		n_rows = rows + (step % 2 ? -(step + 1) / 2 : step / 2);
+		if (n_rows < 1 || n_rows > n_windows)
+			continue;
+
+		for (t = 0; t < 2; t++)
+		{
+			transposed = t;
+			c = solve_rows (windows, n_windows,
+							transposed ? bounds->height : bounds->width,
+							transposed ? bounds->width : bounds->height,
+							n_rows, transposed, deadline, counts);
+			if (c < 0)
+				goto out_of_time;
+
+			if (c < best)
+			{
+				best = c;
+				best_rows = n_rows;
+				best_transposed = transposed;
+				memcpy (best_counts, counts, n_rows * sizeof (int));
+			}
+		}
+	}
+
+out_of_time:
+	if (best_rows > 0)
+	{
+		g_debug ("Tiling %d windows in %d %s", n_windows, best_rows,
+				 best_transposed ? "columns" : "rows");
+		place_rows (bounds, windows, best_counts, best_rows, best_transposed,
+					cells);
+	}
+	else
+	{
+		g_debug ("No tiling found in time, using the grid");
+		ww_engine_tile (bounds, n_windows, cells);
+		fit_cells (windows, n_windows, cells);
+	}
+
+	g_free (counts);
+	g_free (best_counts);
+
+	return TRUE;
+}
+
+/**
+ * ww_engine_tile_waste
+ * @bounds: The tiled area
+ * @cells: The tiles
+ * @n_cells: The number of elements in @cells
+ *
+ * Measure how well a tiling uses @bounds. Area not covered by any cell, and
+ * area of a cell outside the largest 4:3 rectangle that fits in it, counts
+ * as waste. Cells are assumed not to overlap.
+ *
+ * Return value: The wasted fraction of @bounds, between 0 and 1
+ */
+double
+ww_engine_tile_waste (const WwRect	*bounds,
+					  const WwRect	*cells,
+					  int			n_cells)
+{
+	double	area, used, w, h;
+	int		i;
+
+	area = (double) bounds->width * bounds->height;
+	if (area <= 0)
+		return 0;
+
+	used = 0;
+	for (i = 0; i < n_cells; i++)
+	{
+		w = cells[i].width;
+		h = cells[i].height;
+		used += w * h - cell_waste (w, h);
+	}
+
+	return 1.0 - used / area;
+}
+
+/**
+ * ww_engine_twothirds
+ * @bounds: The area to lay out the windows in
+ * @windows: The windows to lay out. One should be flagged %WW_WINDOW_ACTIVE
+ * @n_windows: The number of elements in @windows
+ * @cells: Return location for @n_windows rectangles
+ *
+ * Give the active window the left 2/3 of @bounds and stack the remaining
+ * windows in the right 1/3. A single window is given all of @bounds. The
+ * split follows the size increments of the windows, see
+ * ww_engine_allocate().
+ *
+ * Return value: %FALSE if there is nothing to lay out
+ */
+gboolean
+ww_engine_twothirds (const WwRect		*bounds,
+					 const WwWindowDesc	*windows,
+					 int				n_windows,
+					 WwRect				*cells)
+{
+	WwSizeHints	hints, *right_hints;
+	int			*starts, *sizes;
+	int			dim, row, i, active;
+	int			lg_w, rg_w;
+
+	if (n_windows == 0)
+		return FALSE;
+
+	/* If there is only one window, resize it to fullscreen */
+	if (n_windows == 1)
+	{
+		cells[0] = *bounds;
+		fit_cells (windows, 1, cells);
+		return TRUE;
+	}
+
+	active = -1;
+	for (i = 0; i < n_windows && active < 0; i++)
+		if (windows[i].flags & WW_WINDOW_ACTIVE)
+			active = i;
+
+	/* The right column gets whatever width the active window can't use */
+	lg_w = bounds->width / 3 * 2;
+	if (active >= 0)
+	{
+		ww_engine_get_size_hints (&windows[active], FALSE, &hints);
+		lg_w = MIN (ww_engine_fit_size (&hints, lg_w), bounds->width);
+	}
+	rg_w = bounds->width - lg_w;
+
+	dim = n_windows - (active >= 0 ? 1 : 0);
+	right_hints = g_new (WwSizeHints, dim);
+	starts = g_new (int, dim);
+	sizes = g_new (int, dim);
+
+	for (i = 0, row = 0; i < n_windows; i++)
+		if (i != active)
+			ww_engine_get_size_hints (&windows[i], TRUE, &right_hints[row++]);
+	ww_engine_allocate (bounds->height, right_hints, dim, starts, sizes);
+
+	row = 0;
+	for (i = 0; i < n_windows; i++)
+	{
+		if (i == active)
+		{
+			cells[i].x = bounds->x;
+			cells[i].y = bounds->y;
+			cells[i].width = lg_w;
+			cells[i].height = bounds->height;
+		} else {
+			cells[i].x = lg_w + bounds->x;
+			cells[i].y = starts[row] + bounds->y;
+			cells[i].width = rg_w;
+			cells[i].height = sizes[row];
+			row++;
+		}
+	}
+
+	/* The heights of the right column are already allocated */
+	fit_cells (windows, n_windows, cells);
+
+	g_free (right_hints);
+	g_free (starts);
+	g_free (sizes);
+
+	return TRUE;
+}
+
+/* Order the windows above the expanded window bottom up */
+static int
+compare_bottom_desc (const void *a, const void *b)
+{
+	const WwRect	*ra = *(const WwRect **) a;
+	const WwRect	*rb = *(const WwRect **) b;
+
+	return (rb->y + rb->height) - (ra->y + ra->height);
+}
+
+/* Order the windows below the expanded window top down */
+static int
+compare_top_asc (const void *a, const void *b)
+{
+	const WwRect	*ra = *(const WwRect **) a;
+	const WwRect	*rb = *(const WwRect **) b;
+
+	return ra->y - rb->y;
+}
+
+/* Narrow [*left, *right) so it no longer overlaps @w horizontally, without
+ * losing [x, x_end). Returns FALSE if @w overlaps [x, x_end) */
+static inline gboolean
+avoid_horizontally (const WwRect *w, int x, int x_end, int *left, int *right)
+{
+	if (w->x + w->width <= x)
+	{
+		*left = MAX (*left, w->x + w->width);
+		return TRUE;
+	}
+
+	if (w->x >= x_end)
+	{
+		*right = MIN (*right, w->x);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Find the best bottom edge for a rectangle spanning [left, right) from
+ * @top down, given the windows below @active ordered top down */
+static void
+expand_down (const WwRect	*active,
+			 const WwRect	**below,
+			 int			n_below,
+			 int			area_bottom,
+			 int			top,
+			 int			left,
+			 int			right,
+			 WwRect			*best,
+			 gint64			*best_area)
+{
+	gint64	size;
+	int		bottom, i;
+
+	for (i = 0; ; i++)
+	{
+		bottom = i < n_below ? MIN (below[i]->y, area_bottom) : area_bottom;
+
+		size = (gint64) (right - left) * (bottom - top);
+		if (size > *best_area)
+		{
+			*best_area = size;
+			best->x = left;
+			best->y = top;
+			best->width = right - left;
+			best->height = bottom - top;
+		}
+
+		if (i == n_below || below[i]->y >= area_bottom ||
+			!avoid_horizontally (below[i], active->x,
+								 active->x + active->width, &left, &right))
+			break;
+	}
+}
+
+/**
+ * ww_engine_expand
+ * @area: The area the active window may expand to
+ * @windows: The windows that may block the expansion. Windows flagged
+ *           %WW_WINDOW_ACTIVE are ignored
+ * @n_windows: The number of elements in @windows
+ * @active: The current geometry of the window to expand
+ * @result: Return location for the expanded geometry
+ *
+ * Find the largest rectangle in @area that contains @active and doesn't
+ * overlap any windows @active doesn't already overlap.
+ *
+ * Every such rectangle is bounded by the edges of @area and the windows,
+ * so the top edge is swept upwards through the bottom edges of the windows
+ * above @active, narrowing the horizontal span to avoid each one. For every
+ * span the bottom edge is swept downwards the same way.
+ *
+ * The downward sweep only restarts where a window above narrows the span,
+ * and it stops at the first window below that is in the way of @active
+ * itself. Windows stacked in a staircase on both sides can still make every
+ * window above narrow the span and every window below be swept for each of
+ * them, so the worst case is O(n_above * n_below), ie. O(n^2), on top of
+ * the O(n log n) sorting. Desktop window counts keep that well below a
+ * microsecond per window, see the expand-compare lines of ww-bench.
+ *
+ * Return value: %TRUE
+ */
+gboolean
+ww_engine_expand (const WwRect			*area,
+				  const WwWindowDesc	*windows,
+				  int					n_windows,
+				  const WwRect			*active,
+				  WwRect				*result)
+{
+	const WwRect	**above, **below;
+	const WwRect	*w;
+	WwRect			a;
+	gint64			best_area;
+	int				n_above, n_below, left, right, next_left, next_right;
+	int				area_bottom, top, i;
+
+	/* Only the part of the window inside the area has to be kept */
+	a.x = MAX (active->x, area->x);
+	a.y = MAX (active->y, area->y);
+	a.width = MIN (active->x + active->width, area->x + area->width) - a.x;
+	a.height = MIN (active->y + active->height, area->y + area->height) - a.y;
+	if (a.width <= 0 || a.height <= 0)
+	{
+		*result = *active;
+		return TRUE;
+	}
+
+	above = g_new (const WwRect*, MAX (n_windows, 1));
+	below = g_new (const WwRect*, MAX (n_windows, 1));
+	n_above = n_below = 0;
+	left = area->x;
+	right = area->x + area->width;
+	area_bottom = area->y + area->height;
+
+	for (i = 0; i < n_windows; i++)
+	{
+		w = &windows[i].geometry;
+		if ((windows[i].flags & WW_WINDOW_ACTIVE) ||
+			w->width <= 0 || w->height <= 0)
+			continue;
+
+		/* Windows the active window already overlaps are not in the way */
+		if (w->x < a.x + a.width && w->x + w->width > a.x &&
+			w->y < a.y + a.height && w->y + w->height > a.y)
+			continue;
+
+		if (w->y + w->height <= a.y)
+			above[n_above++] = w;
+		else if (w->y >= a.y + a.height)
+			below[n_below++] = w;
+		else
+			avoid_horizontally (w, a.x, a.x + a.width, &left, &right);
+	}
+
+	qsort (above, n_above, sizeof (const WwRect*), compare_bottom_desc);
+	qsort (below, n_below, sizeof (const WwRect*), compare_top_asc);
+
+	best_area = -1;
+	for (i = 0; ; i++)
+	{
+		top = i < n_above ? MAX (above[i]->y + above[i]->height, area->y)
+						  : area->y;
+
+		next_left = left;
+		next_right = right;
+		if (i < n_above && top > area->y &&
+			avoid_horizontally (above[i], a.x, a.x + a.width,
+								&next_left, &next_right))
+		{
+			/* The span stays the same, so a higher top is always better */
+			if (next_left == left && next_right == right)
+				continue;
+
+			expand_down (&a, below, n_below, area_bottom, top, left, right,
+						 result, &best_area);
+			left = next_left;
+			right = next_right;
+			continue;
+		}
+
+		expand_down (&a, below, n_below, area_bottom, top, left, right,
+					 result, &best_area);
+		break;
+	}
+
+	g_debug ("Expanding window to (%d, %d) @ %dx%d", result->x, result->y,
+			 result->width, result->height);
+
+	g_free (above);
+	g_free (below);
+
+	return TRUE;
+}
+
+/**
+ * ww_snapshot_new
+ *
+ * Return value: A new, empty #WwSnapshot. Free with ww_snapshot_free()
+ */
+WwSnapshot*
+ww_snapshot_new (void)
+{
+	WwSnapshot	*snapshot;
+	
+	snapshot = g_new0 (WwSnapshot, 1);
+	snapshot->monitors = g_array_new (FALSE, FALSE, sizeof (WwMonitor));
+	snapshot->windows = g_array_new (FALSE, FALSE, sizeof (WwWindowDesc));
+	snapshot->struts = g_array_new (FALSE, FALSE, sizeof (WwRect));
+	
+	return snapshot;
+}
+
+/**
+ * ww_snapshot_free
+ * @snapshot: The snapshot to free
+ */
+void
+ww_snapshot_free (WwSnapshot *snapshot)
+{
+	g_return_if_fail (snapshot != NULL);
+	
+	g_array_free (snapshot->monitors, TRUE);
+	g_array_free (snapshot->windows, TRUE);
+	g_array_free (snapshot->struts, TRUE);
+	g_free (snapshot);
+}
+
+/**
+ * ww_snapshot_reset
+ * @snapshot: The snapshot to empty
+ *
+ * Remove all windows and struts from @snapshot, keeping the storage for
+ * refilling it. The monitors are kept.
+ */
+void
+ww_snapshot_reset (WwSnapshot *snapshot)
+{
+	g_return_if_fail (snapshot != NULL);
+	
+	g_array_set_size (snapshot->windows, 0);
+	g_array_set_size (snapshot->struts, 0);
+}
+
+/**
+ * ww_snapshot_classify
+ * @snapshot: The snapshot to add the window to
+ * @desc: The window to classify
+ * @workspace: The number of the current workspace, or %WW_WORKSPACE_ALL to
+ *             use windows on any workspace
+ *
+ * Add a window to the user windows of @snapshot if it is not minimized,
+ * maximized, shaded or skipping the task list and is visible on
+ * @workspace. Add its geometry to the struts if it is a dock on
+ * @workspace. User windows are assigned to one of the monitors of
+ * @snapshot, see ww_engine_find_monitor().
+ */
+void
+ww_snapshot_classify (WwSnapshot			*snapshot,
+					  const WwWindowDesc	*desc,
+					  int					workspace)
+{
+	WwWindowDesc	*added;
+	gboolean		on_workspace;
+	
+	on_workspace = workspace == WW_WORKSPACE_ALL ||
+				   desc->workspace == WW_WORKSPACE_ALL ||
+				   desc->workspace == workspace;
+	
+	if (!on_workspace)
+		return;
+	
+	if (desc->type == WW_WINDOW_TYPE_DOCK)
+		g_array_append_val (snapshot->struts, desc->geometry);
+	
+	if (desc->flags & (WW_WINDOW_SKIP_TASKLIST | WW_WINDOW_MINIMIZED |
+					   WW_WINDOW_MAXIMIZED | WW_WINDOW_SHADED))
+		return;
+	
+	/* Windows on the current workspace must also be in its viewport */
+	if (workspace != WW_WORKSPACE_ALL &&
+		desc->workspace == workspace &&
+		!(desc->flags & WW_WINDOW_IN_VIEWPORT))
+		return;
+	
+	g_array_append_vals (snapshot->windows, desc, 1);
+	
+	added = &g_array_index (snapshot->windows, WwWindowDesc,
+							snapshot->windows->len - 1);
+	added->monitor = ww_engine_find_monitor (
+						(const WwMonitor *) snapshot->monitors->data,
+						snapshot->monitors->len, &desc->geometry);
+}
+
+/**
+ * ww_snapshot_get_input
+ * @snapshot: The snapshot to lay out
+ * @input: The input to fill in
+ *
+ * Point @input at the screen, windows and struts of @snapshot. The input is
+ * valid until @snapshot is changed. The data member of @input is %NULL.
+ */
+void
+ww_snapshot_get_input (WwSnapshot *snapshot, WwEngineInput *input)
+{
+	input->screen = snapshot->screen;
+	input->workarea = snapshot->workarea;
+	input->windows = (const WwWindowDesc *) snapshot->windows->data;
+	input->n_windows = snapshot->windows->len;
+	input->struts = (const WwRect *) snapshot->struts->data;
+	input->n_struts = snapshot->struts->len;
+	input->data = NULL;
+}
+
+/**
+ * ww_engine_find_monitor
+ * @monitors: The monitors to choose from
+ * @n_monitors: The number of elements in @monitors
+ * @rect: The geometry of a window
+ *
+ * Find the monitor a window belongs to. This is the monitor containing the
+ * centre of @rect, or failing that the one @rect overlaps the most.
+ *
+ * Return value: An index into @monitors, or 0 if @n_monitors is 0
+ */
+int
+ww_engine_find_monitor (const WwMonitor	*monitors,
+						int				n_monitors,
+						const WwRect	*rect)
+{
+	const WwRect	*m;
+	int				cx, cy, i, best;
+	gint64			overlap, best_overlap;
+
+	cx = rect->x + rect->width / 2;
+	cy = rect->y + rect->height / 2;
+
+	for (i = 0; i < n_monitors; i++)
+	{
+		m = &monitors[i].geometry;
+		if (cx >= m->x && cx < m->x + m->width &&
+			cy >= m->y && cy < m->y + m->height)
+			return i;
+	}
+
+	best = 0;
+	best_overlap = 0;
+	for (i = 0; i < n_monitors; i++)
+	{
+		m = &monitors[i].geometry;
+		overlap = (gint64) MAX (0, MIN (rect->x + rect->width, m->x + m->width)
+								   - MAX (rect->x, m->x))
+				  * MAX (0, MIN (rect->y + rect->height, m->y + m->height)
+							- MAX (rect->y, m->y));
+		if (overlap > best_overlap)
+		{
+			best = i;
+			best_overlap = overlap;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * ww_snapshot_get_monitor_input
+ * @snapshot: The snapshot to lay out
+ * @monitor: The index of the monitor in @snapshot to lay out
+ * @windows: A #GArray of #WwWindowDesc to collect the windows in. Its
+ *           contents are replaced
+ * @input: The input to fill in
+ *
+ * Point @input at the windows of @snapshot on one monitor. The screen of
+ * @input is the monitor and its bounds are the workarea of the monitor, so
+ * a %WwEngineFunc lays out the monitor as if it was the whole screen. The
+ * input is valid until @snapshot or @windows is changed.
+ */
+void
+ww_snapshot_get_monitor_input (WwSnapshot		*snapshot,
+							   int				monitor,
+							   GArray			*windows,
+							   WwEngineInput	*input)
+{
+	const WwMonitor		*mon;
+	const WwWindowDesc	*desc;
+	guint				i;
+
+	g_return_if_fail (monitor >= 0 && monitor < snapshot->monitors->len);
+
+	g_array_set_size (windows, 0);
+	for (i = 0; i < snapshot->windows->len; i++)
+	{
+		desc = &g_array_index (snapshot->windows, WwWindowDesc, i);
+		if (desc->monitor == monitor)
+			g_array_append_vals (windows, desc, 1);
+	}
+
+	mon = &g_array_index (snapshot->monitors, WwMonitor, monitor);
+	input->screen = mon->geometry;
+	input->workarea = mon->workarea;
+	input->windows = (const WwWindowDesc *) windows->data;
+	input->n_windows = windows->len;
+
+	/* The struts are already taken out of the workarea */
+	input->struts = NULL;
+	input->n_struts = 0;
+	input->data = NULL;
+}
+
+/**
+ * ww_snapshot_run
+ * @snapshot: The snapshot to lay out
+ * @func: The layout function to run
+ * @data: The data member of the input @func gets
+ * @cells: Return location for one rectangle per window of @snapshot
+ *
+ * Run @func on @snapshot like ww_apply_engine_full() does, on each monitor
+ * separately if @snapshot has monitors, but write the result to @cells
+ * instead of a plan. Windows the layout leaves alone get their current
+ * geometry. This only touches @snapshot and @cells, so snapshots can be
+ * laid out in parallel threads.
+ *
+ * Return value: %TRUE if @func returned %TRUE for any monitor
+ */
+gboolean
+ww_snapshot_run (WwSnapshot		*snapshot,
+				 WwEngineFunc	func,
+				 gconstpointer	data,
+				 WwRect			*cells)
+{
+	WwEngineInput		input;
+	const WwWindowDesc	*desc;
+	GArray				*windows;
+	WwRect				*result_cells;
+	guint				i, k, monitor;
+	gboolean			result;
+
+	for (i = 0; i < snapshot->windows->len; i++)
+		cells[i] = g_array_index (snapshot->windows, WwWindowDesc, i).geometry;
+
+	if (snapshot->windows->len == 0)
+		return FALSE;
+
+	/* The layout may have scribbled on the cells before giving up */
+	result_cells = g_new (WwRect, snapshot->windows->len);
+
+	if (snapshot->monitors->len == 0)
+	{
+		ww_snapshot_get_input (snapshot, &input);
+		input.data = data;
+		result = func (&input, result_cells);
+		if (result)
+			memcpy (cells, result_cells, input.n_windows * sizeof (WwRect));
+		g_free (result_cells);
+		return result;
+	}
+
+	windows = g_array_new (FALSE, FALSE, sizeof (WwWindowDesc));
+	result = FALSE;
+	for (monitor = 0; monitor < snapshot->monitors->len; monitor++)
+	{
+		ww_snapshot_get_monitor_input (snapshot, monitor, windows, &input);
+		input.data = data;
+		if (input.n_windows == 0 || !func (&input, result_cells))
+			continue;
+
+		/* The monitor input keeps the order of the snapshot */
+		for (i = 0, k = 0; i < snapshot->windows->len; i++)
+		{
+			desc = &g_array_index (snapshot->windows, WwWindowDesc, i);
+			if (desc->monitor == monitor)
+				cells[i] = result_cells[k++];
+		}
+		result = TRUE;
+	}
+
+	g_array_free (windows, TRUE);
+	g_free (result_cells);
+
+	return result;
+}
+
+static int
+find_active (const WwEngineInput *input)
+{
+	int	i;
+
+	for (i = 0; i < input->n_windows; i++)
+	{
+		if (input->windows[i].flags & WW_WINDOW_ACTIVE)
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * ww_engine_layout_tile
+ * @input: The windows and desktop to lay out
+ * @cells: Return location for one rectangle per window
+ *
+ * A %WwEngineFunc tiling all windows within the desktop bounds. See
+ * ww_engine_tile_optimal().
+ *
+ * Return value: %FALSE if there are no windows
+ */
+gboolean
+ww_engine_layout_tile (const WwEngineInput *input, WwRect *cells)
+{
+	WwRect	bounds;
+
+	if (input->n_windows == 0)
+		return FALSE;
+
+	ww_engine_get_bounds (input, &bounds);
+
+	return ww_engine_tile_optimal (&bounds, input->windows, input->n_windows,
+								   WW_ENGINE_TILE_BUDGET, cells);
+}
+
+/**
+ * ww_engine_layout_twothirds
+ * @input: The windows and desktop to lay out
+ * @cells: Return location for one rectangle per window
+ *
+ * A %WwEngineFunc giving the active window 2/3 of the desktop bounds. See
+ * ww_engine_twothirds().
+ *
+ * Return value: %FALSE if there are no windows, or more than one window
+ *               and none of them is active
+ */
+gboolean
+ww_engine_layout_twothirds (const WwEngineInput *input, WwRect *cells)
+{
+	WwRect	bounds;
+
+	if (input->n_windows == 0)
+		return FALSE;
+
+	/* If there is no active window, do nothing */
+	if (input->n_windows > 1 && find_active (input) < 0)
+	{
+		g_debug ("No active window");
+		return FALSE;
+	}
+
+	ww_engine_get_bounds (input, &bounds);
+
+	return ww_engine_twothirds (&bounds, input->windows, input->n_windows,
+								cells);
+}
+
+/**
+ * ww_engine_layout_expand
+ * @input: The windows and desktop to lay out
+ * @cells: Return location for one rectangle per window
+ *
+ * A %WwEngineFunc expanding the active window over the free space of the
+ * desktop, see ww_engine_get_bounds() and ww_engine_expand(). All other
+ * windows keep their geometry.
+ *
+ * Return value: %FALSE if no window is active
+ */
+gboolean
+ww_engine_layout_expand (const WwEngineInput *input, WwRect *cells)
+{
+	WwRect	bounds;
+	int		active, i;
+
+	active = find_active (input);
+	if (active < 0)
+		return FALSE;
+
+	for (i = 0; i < input->n_windows; i++)
+		cells[i] = input->windows[i].geometry;
+
+	ww_engine_get_bounds (input, &bounds);
+	return ww_engine_expand (&bounds, input->windows, input->n_windows,
+							 &input->windows[active].geometry, &cells[active]);
+}
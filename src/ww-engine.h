@@ -0,0 +1,246 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The layout engine holds the geometry code of the layouts. It only depends
+ * on GLib and works on plain rectangles, so it can run, be tested and be
+ * benchmarked without an X server. The layout handlers in
+ * ww-layout-<name>.c translate between libwnck and the engine.
+ */
+
+#ifndef _WW_ENGINE_H_
+#define _WW_ENGINE_H_
+
+#include <glib.h>
+
+#include "ww-spatial.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+	int x;
+	int y;
+	int width;
+	int height;
+} WwRect;
+
+typedef enum
+{
+	WW_WINDOW_ACTIVE		= 1 << 0,
+	WW_WINDOW_SKIP_TASKLIST	= 1 << 1,
+	WW_WINDOW_MINIMIZED		= 1 << 2,
+	WW_WINDOW_MAXIMIZED		= 1 << 3,
+	WW_WINDOW_SHADED		= 1 << 4,
+	WW_WINDOW_IN_VIEWPORT	= 1 << 5	/* visible in the current viewport */
+} WwWindowFlags;
+
+typedef enum
+{
+	WW_WINDOW_TYPE_NORMAL,
+	WW_WINDOW_TYPE_DOCK,	/* panels and docks, treated as struts */
+	WW_WINDOW_TYPE_OTHER
+} WwWindowType;
+
+/* Time ww_engine_layout_tile() may spend searching for a tiling, in
+ * microseconds */
+#define WW_ENGINE_TILE_BUDGET 500
+
+/* Workspace number of windows that are on all workspaces. Passed to
+ * ww_snapshot_classify() it means "don't filter on workspace" */
+#define WW_WORKSPACE_ALL -1
+
+/* Everything the engine needs to know about a window */
+typedef struct
+{
+	WwRect			geometry;
+	guint			flags;
+	WwWindowType	type;
+	int				workspace;
+	int				monitor;	/* set by ww_snapshot_classify() */
+	int				min_width;	/* WM_NORMAL_HINTS as frame sizes, 0 if unset */
+	int				min_height;
+	int				base_width;	/* sizes are base plus a multiple of inc */
+	int				base_height;
+	int				width_inc;	/* 0 or 1 if any size will do */
+	int				height_inc;
+	guint			class_hash;	/* g_str_hash() of the WM_CLASS class, or 0 */
+	gpointer		data;
+} WwWindowDesc;
+
+/* The sizes a window accepts along one axis: @base plus a multiple of
+ * @inc, and at least @min. See ww_engine_fit_size() */
+typedef struct
+{
+	int min;
+	int base;
+	int inc;
+} WwSizeHints;
+
+/* A monitor and the part of it not covered by struts */
+typedef struct
+{
+	WwRect		geometry;
+	WwRect		workarea;
+} WwMonitor;
+
+/* The space reserved by a window along the screen edges, as in the EWMH
+ * _NET_WM_STRUT_PARTIAL property. The widths are measured from the edges of
+ * the whole screen and the start and end coordinates are inclusive */
+typedef struct
+{
+	int left;
+	int right;
+	int top;
+	int bottom;
+	int left_start_y;
+	int left_end_y;
+	int right_start_y;
+	int right_end_y;
+	int top_start_x;
+	int top_end_x;
+	int bottom_start_x;
+	int bottom_end_x;
+} WwStrut;
+
+/* The windows of a desktop sorted into the ones layouts may move and the
+ * ones blocking them. The arrays keep their storage when the snapshot is
+ * reset, so refilling it doesn't allocate once it has grown to size */
+typedef struct
+{
+	WwRect		screen;
+	WwRect		workarea;	/* empty if unknown, see ww_engine_get_bounds() */
+	GArray		*monitors;	/* of WwMonitor, may be empty */
+	GArray		*windows;	/* of WwWindowDesc */
+	GArray		*struts;	/* of WwRect */
+} WwSnapshot;
+
+/* Everything a layout needs to compute new window geometries */
+typedef struct
+{
+	WwRect				screen;
+	WwRect				workarea;
+	const WwRect		*struts;
+	int					n_struts;
+	const WwWindowDesc	*windows;
+	int					n_windows;
+	gconstpointer		data;	/* the data member of the WwLayout, if any */
+} WwEngineInput;
+
+/* A pure layout function. It writes one rectangle per input window to
+ * @cells, windows that should stay put get their current geometry.
+ * Returns %FALSE if the layout has nothing to do */
+typedef gboolean (*WwEngineFunc) (const WwEngineInput	*input,
+								  WwRect				*cells);
+
+void				ww_engine_grid_size			(int count,
+												 int *cols,
+												 int *rows);
+
+void				ww_engine_calc_bounds		(const WwRect *screen,
+												 const WwRect *struts,
+												 int n_struts,
+												 WwRect *bounds);
+
+void				ww_engine_calc_workarea		(const WwRect *screen,
+												 const WwRect *monitor,
+												 const WwStrut *struts,
+												 int n_struts,
+												 WwRect *workarea);
+
+void				ww_engine_get_bounds		(const WwEngineInput *input,
+												 WwRect *bounds);
+
+void				ww_engine_get_size_hints	(const WwWindowDesc *window,
+												 gboolean vertical,
+												 WwSizeHints *hints);
+
+int					ww_engine_fit_size			(const WwSizeHints *hints,
+												 int size);
+
+void				ww_engine_allocate			(int length,
+												 const WwSizeHints *hints,
+												 int n,
+												 int *starts,
+												 int *sizes);
+
+gboolean			ww_engine_tile				(const WwRect *bounds,
+												 int n_windows,
+												 WwRect *cells);
+
+gboolean			ww_engine_tile_optimal		(const WwRect *bounds,
+												 const WwWindowDesc *windows,
+												 int n_windows,
+												 gint64 budget,
+												 WwRect *cells);
+
+double				ww_engine_tile_waste		(const WwRect *bounds,
+												 const WwRect *cells,
+												 int n_cells);
+
+gboolean			ww_engine_twothirds			(const WwRect *bounds,
+												 const WwWindowDesc *windows,
+												 int n_windows,
+												 WwRect *cells);
+
+gboolean			ww_engine_expand			(const WwRect *area,
+												 const WwWindowDesc *windows,
+												 int n_windows,
+												 const WwRect *active,
+												 WwRect *result);
+
+WwSnapshot*			ww_snapshot_new				(void);
+
+void				ww_snapshot_free			(WwSnapshot *snapshot);
+
+void				ww_snapshot_reset			(WwSnapshot *snapshot);
+
+void				ww_snapshot_classify		(WwSnapshot *snapshot,
+												 const WwWindowDesc *desc,
+												 int workspace);
+
+void				ww_snapshot_get_input		(WwSnapshot *snapshot,
+												 WwEngineInput *input);
+
+int					ww_engine_find_monitor		(const WwMonitor *monitors,
+												 int n_monitors,
+												 const WwRect *rect);
+
+void				ww_snapshot_get_monitor_input	(WwSnapshot *snapshot,
+												 int monitor,
+												 GArray *windows,
+												 WwEngineInput *input);
+
+gboolean			ww_snapshot_run				(WwSnapshot *snapshot,
+												 WwEngineFunc func,
+												 gconstpointer data,
+												 WwRect *cells);
+
+gboolean			ww_engine_layout_tile		(const WwEngineInput *input,
+												 WwRect *cells);
+
+gboolean			ww_engine_layout_twothirds	(const WwEngineInput *input,
+												 WwRect *cells);
+
+gboolean			ww_engine_layout_expand		(const WwEngineInput *input,
+												 WwRect *cells);
+
+G_END_DECLS
+
+#endif /* _WW_ENGINE_H_ */
@@ -6,7 +6,7 @@
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation, either version 3 of the License, or
  *  (at your option) any later version.
- *  
+ *
  *  WinWrangler is distributed in the hope that it will be useful,
  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
@@ -16,108 +16,431 @@
  *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "winwrangler.h"
+/*
+ * Hotkeys are grabbed on the root window with XGrabKey. The X server only
+ * matches a grab if the modifier state is exactly the grabbed one, so each
+ * hotkey is grabbed once for every combination of the lock modifiers (Caps
+ * Lock, Num Lock and Scroll Lock) that may be on.
+ *
+ * The keycodes and real modifiers of the hotkeys are worked out once, into
+ * a hash table from keycode and modifier state to the WwLayout. A key press
+ * is a single lookup in that table. The table and the grabs are only
+ * rebuilt when the keyboard mapping changes, as announced by MappingNotify
+ * or, with XKB, the "keys-changed" signal of the GdkKeymap.
+ *
+ * The hotkeys are the default_hotkey of each layout, unless the user
+ * changed them in ~/.config/hotkeys/winwrangler.hotkeys, which has a group
+ * for each layout name with the accelerator in a Signature key.
+ */
 
-#include <gtkhotkey.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+
+#include "winwrangler.h"
 
 #define HOTKEY_APP_ID "winwrangler"
 
+/* The X modifiers that can be part of a hotkey */
+#define HOTKEY_REAL_MODS (ShiftMask | LockMask | ControlMask | Mod1Mask | \
+						  Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
+
+/* A hotkey as the user wrote it */
+typedef struct
+{
+	const WwLayout	*layout;
+	gchar			*signature;
+	guint			keyval;
+	GdkModifierType	modifiers;	/* may include virtual modifiers */
+} WwHotkey;
+
+/* A grab on the root window, without the lock modifiers */
+typedef struct
+{
+	KeyCode			keycode;
+	guint			modifiers;
+} WwGrab;
+
+static GArray		*hotkeys = NULL;		/* of WwHotkey */
+static GArray		*grabs = NULL;			/* of WwGrab */
+static GHashTable	*hotkey_table = NULL;	/* grab key -> WwLayout */
+static GKeyFile		*hotkey_file = NULL;
+static guint		lock_mods[8];			/* combinations of the locks */
+static guint		n_lock_mods = 0;
+static guint		ignored_mods = 0;		/* all lock modifiers */
+static guint		rebuild_source = 0;
+
+/* The key of @keycode and @modifiers in hotkey_table */
+#define GRAB_KEY(keycode, modifiers) \
+	GUINT_TO_POINTER ((guint) (keycode) | ((modifiers) << 8))
+
+/* The current keyboard mapping, only valid during rebuild_table() */
+typedef struct
+{
+	int				min_keycode;
+	int				max_keycode;
+	int				keysyms_per_keycode;
+	KeySym			*keysyms;
+	guint			super_mod;
+	guint			hyper_mod;
+	guint			meta_mod;
+} WwKeyboard;
+
+static KeySym
+get_keysym (const WwKeyboard *keyboard, int keycode, int level)
+{
+	if (keycode < keyboard->min_keycode || keycode > keyboard->max_keycode ||
+		level >= keyboard->keysyms_per_keycode)
+		return NoSymbol;
+
+	return keyboard->keysyms[(keycode - keyboard->min_keycode) *
+							 keyboard->keysyms_per_keycode + level];
+}
+
+/* Find the real modifiers the lock keys and the virtual modifiers are on */
 static void
-on_hotkey_activated (GtkHotkeyInfo *hotkey, guint event_time, WwLayout *layout)
+read_modifiers (Display *display, WwKeyboard *keyboard)
 {
-	g_message ("Hotkey %s for '%s' activated",
-		 gtk_hotkey_info_get_signature (hotkey),
-		 layout->name);
+	XModifierKeymap	*map;
+	KeySym			keysym;
+	KeyCode			keycode;
+	guint			mod, num_lock, scroll_lock, i;
+	int				k, level;
+
+	num_lock = scroll_lock = 0;
+	keyboard->super_mod = keyboard->hyper_mod = keyboard->meta_mod = 0;
+
+	map = XGetModifierMapping (display);
+	for (mod = 0; mod < 8; mod++)
+	{
+		for (k = 0; k < map->max_keypermod; k++)
+		{
+			keycode = map->modifiermap[mod * map->max_keypermod + k];
+			for (level = 0; level < keyboard->keysyms_per_keycode; level++)
+			{
+				keysym = get_keysym (keyboard, keycode, level);
+				if (keysym == XK_Num_Lock)
+					num_lock |= 1 << mod;
+				else if (keysym == XK_Scroll_Lock)
+					scroll_lock |= 1 << mod;
+				else if (keysym == XK_Super_L || keysym == XK_Super_R)
+					keyboard->super_mod |= 1 << mod;
+				else if (keysym == XK_Hyper_L || keysym == XK_Hyper_R)
+					keyboard->hyper_mod |= 1 << mod;
+				else if (keysym == XK_Meta_L || keysym == XK_Meta_R)
+					keyboard->meta_mod |= 1 << mod;
+			}
+		}
+	}
+	XFreeModifiermap (map);
+
+	/* Caps Lock is always Lock. Keep only the real modifiers the virtual
+	 * ones don't share with a lock */
+	ignored_mods = LockMask | num_lock | scroll_lock;
+	keyboard->super_mod &= ~ignored_mods;
+	keyboard->hyper_mod &= ~ignored_mods;
+	keyboard->meta_mod &= ~ignored_mods;
+	if (keyboard->super_mod == 0)
+		keyboard->super_mod = Mod4Mask & ~ignored_mods;
 
-	ww_set_event_time (event_time);
-	ww_apply_layout_by_name (layout->name);
+	/* Every subset of the lock modifiers */
+	n_lock_mods = 0;
+	for (i = 0; i <= ignored_mods; i++)
+		if ((i & ~ignored_mods) == 0 && n_lock_mods < G_N_ELEMENTS (lock_mods))
+			lock_mods[n_lock_mods++] = i;
 }
 
-gboolean
-ww_hotkey_bind_layout (WwLayout *layout)
-{
-	GtkHotkeyInfo *hotkey;
-	GtkHotkeyRegistry *hotkey_registry;
-	GError *error;
-	
-	g_return_val_if_fail(layout != NULL, FALSE);
-	
-	error = NULL;
-	hotkey = NULL;
-	hotkey_registry = gtk_hotkey_registry_get_default ();
-	hotkey = gtk_hotkey_registry_get_hotkey (hotkey_registry,
-						 HOTKEY_APP_ID,
-						 layout->name,
-						 &error);
-	
-	if (error)
+static guint
+get_real_modifiers (const WwKeyboard *keyboard, GdkModifierType modifiers)
+{
+	guint	real;
+
+	real = modifiers & HOTKEY_REAL_MODS;
+	if (modifiers & GDK_SUPER_MASK)
+		real |= keyboard->super_mod;
+	if (modifiers & GDK_HYPER_MASK)
+		real |= keyboard->hyper_mod;
+	if (modifiers & GDK_META_MASK)
+		real |= keyboard->meta_mod;
+
+	return real & ~ignored_mods;
+}
+
+/* Grab @keycode with @modifiers in every lock state. Returns %FALSE if
+ * another client has it */
+static gboolean
+grab_key (Display *display, Window root, KeyCode keycode, guint modifiers)
+{
+	WwGrab	grab;
+	guint	i;
+
+	gdk_error_trap_push ();
+	for (i = 0; i < n_lock_mods; i++)
+		XGrabKey (display, keycode, modifiers | lock_mods[i], root, True,
+				  GrabModeAsync, GrabModeAsync);
+	gdk_flush ();
+
+	/* Some of the lock states may have been grabbed. Ungrabbing them all
+	 * later is harmless, ungrabbing another client's grab does nothing */
+	grab.keycode = keycode;
+	grab.modifiers = modifiers;
+	g_array_append_val (grabs, grab);
+
+	return gdk_error_trap_pop () == 0;
+}
+
+static void
+ungrab_keys (Display *display, Window root)
+{
+	WwGrab	*grab;
+	guint	i, j;
+
+	gdk_error_trap_push ();
+	for (i = 0; i < grabs->len; i++)
+	{
+		grab = &g_array_index (grabs, WwGrab, i);
+		for (j = 0; j < n_lock_mods; j++)
+			XUngrabKey (display, grab->keycode,
+						grab->modifiers | lock_mods[j], root);
+	}
+	gdk_error_trap_pop ();
+
+	g_array_set_size (grabs, 0);
+}
+
+/* Grab every keycode @hotkey is on and add them to the table */
+static void
+grab_hotkey (Display			*display,
+			 Window				root,
+			 const WwKeyboard	*keyboard,
+			 const WwHotkey		*hotkey)
+{
+	KeySym		keysym;
+	guint		modifiers, level_mods;
+	int			keycode, level;
+	gboolean	found;
+
+	modifiers = get_real_modifiers (keyboard, hotkey->modifiers);
+	keysym = hotkey->keyval;
+
+	/* Prefer the keys with the symbol at the base level. Failing that a
+	 * shifted symbol can be grabbed with Shift */
+	found = FALSE;
+	for (level = 0; level < MIN (keyboard->keysyms_per_keycode, 2) && !found;
+		 level++)
 	{
-		if (error->code != GTK_HOTKEY_REGISTRY_ERROR_UNKNOWN_APP &&
-		    error->code != GTK_HOTKEY_REGISTRY_ERROR_UNKNOWN_KEY)
+		level_mods = modifiers | (level == 1 ? ShiftMask : 0);
+		for (keycode = keyboard->min_keycode;
+			 keycode <= keyboard->max_keycode; keycode++)
 		{
-			g_critical ("Error binding hotkey for '%s': %s",
-				    layout->name, error->message);
-			goto clean_up;
+			if (get_keysym (keyboard, keycode, level) != keysym)
+				continue;
+			found = TRUE;
+
+			if (g_hash_table_lookup (hotkey_table,
+									 GRAB_KEY (keycode, level_mods)))
+			{
+				g_warning ("Hotkey %s for '%s' is already used by another "
+						   "layout", hotkey->signature, hotkey->layout->name);
+				continue;
+			}
+
+			if (!grab_key (display, root, keycode, level_mods))
+			{
+				g_warning ("Hotkey %s for '%s' is grabbed by another "
+						   "application", hotkey->signature,
+						   hotkey->layout->name);
+				continue;
+			}
+
+			g_hash_table_insert (hotkey_table, GRAB_KEY (keycode, level_mods),
+								 (gpointer) hotkey->layout);
 		}
-		
-		/* It's OK. The error is just that the app or key is unknown */
+	}
+
+	if (!found)
+		g_warning ("No key produces %s for '%s'", hotkey->signature,
+				   hotkey->layout->name);
+}
+
+/* Work out the keycodes and modifiers of all hotkeys and grab them */
+static void
+rebuild_table (void)
+{
+	Display		*display;
+	Window		root;
+	WwKeyboard	keyboard;
+	guint		i;
+
+	display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+	root = GDK_WINDOW_XID (gdk_get_default_root_window ());
+
+	ungrab_keys (display, root);
+	g_hash_table_remove_all (hotkey_table);
+
+	XDisplayKeycodes (display, &keyboard.min_keycode, &keyboard.max_keycode);
+	keyboard.keysyms = XGetKeyboardMapping (display, keyboard.min_keycode,
+											keyboard.max_keycode -
+											keyboard.min_keycode + 1,
+											&keyboard.keysyms_per_keycode);
+	read_modifiers (display, &keyboard);
+
+	for (i = 0; i < hotkeys->len; i++)
+		grab_hotkey (display, root, &keyboard,
+					 &g_array_index (hotkeys, WwHotkey, i));
+
+	XFree (keyboard.keysyms);
+
+	g_debug ("Grabbed %u keys for %u hotkeys", grabs->len, hotkeys->len);
+}
+
+static gboolean
+on_rebuild (gpointer data)
+{
+	rebuild_source = 0;
+	rebuild_table ();
+
+	return FALSE;
+}
+
+/* Changes to the mapping come in bursts, rebuild once they are over */
+static void
+queue_rebuild (void)
+{
+	if (rebuild_source == 0)
+		rebuild_source = g_idle_add (on_rebuild, NULL);
+}
+
+static void
+on_keys_changed (GdkKeymap *keymap, gpointer data)
+{
+	queue_rebuild ();
+}
+
+static GdkFilterReturn
+on_x_event (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
+{
+	XEvent			*xevent;
+	const WwLayout	*layout;
+
+	xevent = (XEvent *) gdk_xevent;
+
+	if (xevent->type == MappingNotify)
+	{
+		if (xevent->xmapping.request != MappingPointer)
+			queue_rebuild ();
+		return GDK_FILTER_CONTINUE;
+	}
+
+	if (xevent->type != KeyPress)
+		return GDK_FILTER_CONTINUE;
+
+	layout = g_hash_table_lookup (hotkey_table,
+								  GRAB_KEY (xevent->xkey.keycode,
+											xevent->xkey.state &
+											HOTKEY_REAL_MODS & ~ignored_mods));
+	if (layout == NULL)
+		return GDK_FILTER_CONTINUE;
+
+	g_debug ("Hotkey for '%s' activated", layout->name);
+
+	/* The dispatcher records the hotkey phase when the layout is applied */
+	ww_dispatch_request (layout, xevent->xkey.time);
+
+	return GDK_FILTER_REMOVE;
+}
+
+/* The hotkeys the user changed, if any */
+static GKeyFile*
+get_hotkey_file (void)
+{
+	gchar	*path;
+	GError	*error;
+
+	if (hotkey_file)
+		return hotkey_file;
+
+	hotkey_file = g_key_file_new ();
+	path = g_build_filename (g_get_user_config_dir (), "hotkeys",
+							 HOTKEY_APP_ID ".hotkeys", NULL);
+
+	error = NULL;
+	if (!g_key_file_load_from_file (hotkey_file, path, G_KEY_FILE_NONE,
+									&error))
+	{
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_warning ("Failed to read %s: %s", path, error->message);
 		g_error_free (error);
-		error = NULL;
 	}
-	
-	/* If the hotkey is not stored, create it and and store it */
-	if (hotkey == NULL) {
-		hotkey = gtk_hotkey_info_new (HOTKEY_APP_ID,
-					      layout->name,
-					      layout->default_hotkey,
-					      NULL);
-		gtk_hotkey_info_set_description (hotkey,
-						 layout->desc);
-		
-		if (hotkey == NULL) {
-			g_critical ("Error creating hotkey %s for '%s'",
-				    layout->default_hotkey,
-				    layout->name);
-			goto clean_up;
-		}
-		
-		gtk_hotkey_registry_store_hotkey (hotkey_registry,
-						  hotkey,
-						  &error);
-		if (error) {
-			g_critical ("Error storing hotkey %s for '%s': %s",
-				    layout->default_hotkey,
-				    layout->name,
-				    error->message);
-			goto clean_up;
-		}
+
+	g_free (path);
+
+	return hotkey_file;
+}
+
+static void
+ensure_hotkeys (void)
+{
+	if (hotkeys)
+		return;
+
+	hotkeys = g_array_new (FALSE, FALSE, sizeof (WwHotkey));
+	grabs = g_array_new (FALSE, FALSE, sizeof (WwGrab));
+	hotkey_table = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	gdk_window_add_filter (NULL, on_x_event, NULL);
+	g_signal_connect (gdk_keymap_get_default (), "keys-changed",
+					  G_CALLBACK (on_keys_changed), NULL);
+}
+
+/**
+ * ww_hotkey_bind_layout
+ * @layout: The layout to bind
+ *
+ * Grab the hotkey of @layout, so pressing it requests @layout from the
+ * dispatcher. The hotkey is the one set for the layout name in the user's
+ * winwrangler.hotkeys file, or else the default_hotkey of @layout. Layouts
+ * without either are skipped.
+ *
+ * Return value: %FALSE if the hotkey is not a valid accelerator
+ */
+gboolean
+ww_hotkey_bind_layout (const WwLayout *layout)
+{
+	WwHotkey	hotkey;
+	gchar		*signature;
+
+	g_return_val_if_fail (layout != NULL, FALSE);
+
+	ensure_hotkeys ();
+
+	signature = g_key_file_get_string (get_hotkey_file (), layout->name,
+									   "Signature", NULL);
+	if (signature == NULL && layout->default_hotkey == NULL)
+	{
+		g_debug ("No hotkey for '%s'", layout->name);
+		return TRUE;
 	}
-	
-	/* Bind the hotkey */
-	gtk_hotkey_info_bind (hotkey, &error);
-	if (error) {
-		g_critical ("Error binding hotkey %s for '%s': %s",
-			    gtk_hotkey_info_get_signature(hotkey),
-			    layout->name,
-			    error->message);
-		goto clean_up;
+	if (signature == NULL)
+		signature = g_strdup (layout->default_hotkey);
+
+	hotkey.layout = layout;
+	hotkey.signature = signature;
+	gtk_accelerator_parse (signature, &hotkey.keyval, &hotkey.modifiers);
+	if (hotkey.keyval == 0)
+	{
+		g_critical ("Error binding hotkey %s for '%s': not a valid "
+					"accelerator", signature, layout->name);
+		g_free (signature);
+		return FALSE;
 	}
-	
-	/* Attach callbacks to hotkey events */
-	g_signal_connect (hotkey, "activated",
-                      G_CALLBACK(on_hotkey_activated), layout);
-	
-	g_debug("Bound hotkey %s for '%s'",
-		gtk_hotkey_info_get_signature(hotkey),
-		layout->name);
-	
-	clean_up:
-	    if (hotkey_registry) g_object_unref (hotkey_registry);
-	    if (hotkey) g_object_unref (hotkey);
-	    if (error) {
-		    g_error_free (error);
-		    return FALSE;
-	    }
-	
+
+	g_array_append_val (hotkeys, hotkey);
+
+	/* Bindings come in one go at startup, so grab them together */
+	queue_rebuild ();
+
+	g_debug ("Bound hotkey %s for '%s'", signature, layout->name);
+
 	return TRUE;
 }
@@ -0,0 +1,383 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A running daemon listens on a UNIX socket in the user's runtime
+ * directory, one per X display, so 'winwrangler --layout' can hand the
+ * layout to it instead of connecting to the X server and reading all
+ * windows itself.
+ *
+ * The protocol is one line per connection in each direction. The client
+ * sends "layout <name>", or "layout-all <name>" for all workspaces, and the
+ * daemon answers "ok" once the layout has been applied, or
+ * "error <message>".
+ *
+ * A "layout" command goes through the dispatcher like a hotkey, so it is
+ * ordered with the hotkeys pressed around it and applied at most once per
+ * frame. The reply is sent when the dispatcher has applied it.
+ */
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib/gstdio.h>
+
+#include "winwrangler.h"
+
+/* How long a client waits for the daemon, in seconds */
+#define WW_IPC_TIMEOUT 5
+
+static GSocketService	*ipc_service = NULL;
+static gchar			*ipc_path = NULL;
+
+/* The socket of the daemon for the current $DISPLAY */
+static gchar*
+get_socket_path (void)
+{
+	gchar	*display, *name, *path;
+
+	display = g_strdup (g_getenv ("DISPLAY"));
+	if (display == NULL)
+		display = g_strdup ("none");
+	g_strdelimit (display, "/", '_');
+
+	name = g_strdup_printf ("winwrangler-%s", display);
+	path = g_build_filename (g_get_user_runtime_dir (), name, NULL);
+
+	g_free (name);
+	g_free (display);
+
+	return path;
+}
+
+static void
+send_reply (GSocketConnection *connection, const gchar *reply)
+{
+	GOutputStream	*out;
+	GError			*error;
+
+	error = NULL;
+	out = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+	if (!g_output_stream_write_all (out, reply, strlen (reply), NULL, NULL,
+									&error) ||
+		!g_output_stream_write_all (out, "\n", 1, NULL, NULL, &error))
+	{
+		g_warning ("Failed to reply to client: %s", error->message);
+		g_error_free (error);
+	}
+}
+
+static void
+on_layout_applied (const WwLayout *layout, const GError *error, gpointer data)
+{
+	GSocketConnection	*connection;
+	gchar				*reply;
+
+	connection = G_SOCKET_CONNECTION (data);
+
+	if (error)
+		reply = g_strdup_printf ("error %s", error->message);
+	else
+		reply = g_strdup ("ok");
+
+	send_reply (connection, reply);
+
+	g_free (reply);
+	g_object_unref (connection);
+}
+
+/* Run @command from the client on @connection. Returns the reply, or NULL
+ * if on_layout_applied() sends it later */
+static gchar*
+run_command (GSocketConnection *connection, const gchar *command)
+{
+	const WwLayout	*layout;
+	const gchar		*layout_name;
+	GError			*error;
+	gchar			*reply;
+
+	/* Clients have no event time to hand us */
+	if (g_str_has_prefix (command, "layout-all "))
+	{
+		layout_name = command + strlen ("layout-all ");
+		ww_set_event_time (0);
+
+		error = NULL;
+		if (!ww_apply_layout_everywhere (layout_name, &error))
+		{
+			reply = g_strdup_printf ("error %s", error->message);
+			g_error_free (error);
+			return reply;
+		}
+
+		return g_strdup ("ok");
+	}
+
+	if (!g_str_has_prefix (command, "layout "))
+		return g_strdup_printf ("error Unknown command '%s'", command);
+
+	layout_name = command + strlen ("layout ");
+	layout = ww_get_layout (layout_name);
+	if (layout == NULL)
+		return g_strdup_printf ("error No such layout: '%s'", layout_name);
+
+	ww_dispatch_request_full (layout, 0, on_layout_applied,
+							  g_object_ref (connection));
+
+	return NULL;
+}
+
+static void
+on_command_read (GObject *source, GAsyncResult *result, gpointer data)
+{
+	GSocketConnection	*connection;
+	GError				*error;
+	gchar				*command, *reply;
+
+	connection = G_SOCKET_CONNECTION (data);
+
+	error = NULL;
+	command = g_data_input_stream_read_line_finish (G_DATA_INPUT_STREAM (source),
+													result, NULL, &error);
+	if (command == NULL)
+	{
+		if (error)
+		{
+			g_warning ("Failed to read from client: %s", error->message);
+			g_error_free (error);
+		}
+		goto out;
+	}
+
+	g_debug ("Client command: %s", command);
+	reply = run_command (connection, command);
+	if (reply)
+	{
+		send_reply (connection, reply);
+		g_free (reply);
+	}
+
+	g_free (command);
+
+out:
+	g_object_unref (source);
+	g_object_unref (connection);
+}
+
+static gboolean
+on_incoming (GSocketService		*service,
+			 GSocketConnection	*connection,
+			 GObject			*source_object,
+			 gpointer			data)
+{
+	GDataInputStream	*in;
+
+	in = g_data_input_stream_new (
+			g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	g_data_input_stream_read_line_async (in, G_PRIORITY_DEFAULT, NULL,
+										 on_command_read,
+										 g_object_ref (connection));
+
+	return TRUE;
+}
+
+/* Whether a daemon answers on @path */
+static gboolean
+daemon_is_listening (const gchar *path)
+{
+	GSocketClient		*client;
+	GSocketConnection	*connection;
+	GSocketAddress		*address;
+
+	client = g_socket_client_new ();
+	address = g_unix_socket_address_new (path);
+	connection = g_socket_client_connect (client,
+										  G_SOCKET_CONNECTABLE (address),
+										  NULL, NULL);
+	g_object_unref (address);
+	g_object_unref (client);
+
+	if (connection == NULL)
+		return FALSE;
+
+	g_object_unref (connection);
+	return TRUE;
+}
+
+/**
+ * ww_ipc_listen
+ * @error: Return location for a #GError or %NULL
+ *
+ * Start accepting layout requests from 'winwrangler --layout' on the
+ * socket of the current display. A socket left behind by a daemon that
+ * died is replaced.
+ *
+ * Return value: %FALSE if the socket could not be set up, eg. because
+ *               another daemon is already running
+ */
+gboolean
+ww_ipc_listen (GError **error)
+{
+	GSocketAddress	*address;
+	gboolean		result;
+
+	g_return_val_if_fail (ipc_service == NULL, FALSE);
+
+	ipc_path = get_socket_path ();
+
+	if (g_file_test (ipc_path, G_FILE_TEST_EXISTS))
+	{
+		if (daemon_is_listening (ipc_path))
+		{
+			g_set_error (error, WW_ERROR, WW_ERROR_DAEMON_RUNNING,
+						 "Another winwrangler daemon is listening on %s",
+						 ipc_path);
+			g_free (ipc_path);
+			ipc_path = NULL;
+			return FALSE;
+		}
+		g_unlink (ipc_path);
+	}
+
+	ipc_service = g_socket_service_new ();
+	address = g_unix_socket_address_new (ipc_path);
+	result = g_socket_listener_add_address (G_SOCKET_LISTENER (ipc_service),
+											address, G_SOCKET_TYPE_STREAM,
+											G_SOCKET_PROTOCOL_DEFAULT,
+											NULL, NULL, error);
+	g_object_unref (address);
+
+	if (!result)
+	{
+		g_object_unref (ipc_service);
+		ipc_service = NULL;
+		g_free (ipc_path);
+		ipc_path = NULL;
+		return FALSE;
+	}
+
+	g_signal_connect (ipc_service, "incoming", G_CALLBACK (on_incoming), NULL);
+	g_socket_service_start (ipc_service);
+
+	g_debug ("Listening on %s", ipc_path);
+
+	return TRUE;
+}
+
+/**
+ * ww_ipc_shutdown
+ *
+ * Stop accepting requests and remove the socket
+ */
+void
+ww_ipc_shutdown (void)
+{
+	if (ipc_service == NULL)
+		return;
+
+	g_socket_service_stop (ipc_service);
+	g_socket_listener_close (G_SOCKET_LISTENER (ipc_service));
+	g_object_unref (ipc_service);
+	ipc_service = NULL;
+
+	g_unlink (ipc_path);
+	g_free (ipc_path);
+	ipc_path = NULL;
+}
+
+/**
+ * ww_ipc_forward_layout
+ * @layout_name: The layout to apply
+ * @everywhere: Whether to apply it to all workspaces, see
+ *              ww_apply_layout_everywhere()
+ * @round_trip: Return location for the time until the daemon answered, in
+ *              microseconds, or %NULL
+ * @error: Return location for the error reported by the daemon, or %NULL
+ *
+ * Ask a running daemon to apply a layout and wait for it to finish. This
+ * only needs GLib, so it can be called before gtk_init().
+ *
+ * Return value: %FALSE if no daemon is running, in which case the layout
+ *               should be applied in process. Errors from the daemon are
+ *               returned in @error with a return value of %TRUE
+ */
+gboolean
+ww_ipc_forward_layout (const gchar	*layout_name,
+					   gboolean		everywhere,
+					   gint64		*round_trip,
+					   GError		**error)
+{
+	GSocketClient		*client;
+	GSocketConnection	*connection;
+	GSocketAddress		*address;
+	GDataInputStream	*in;
+	GOutputStream		*out;
+	gchar				*path, *command, *reply;
+	gint64				start;
+
+	g_return_val_if_fail (layout_name != NULL, FALSE);
+
+	start = g_get_monotonic_time ();
+
+	path = get_socket_path ();
+	client = g_socket_client_new ();
+	g_socket_client_set_timeout (client, WW_IPC_TIMEOUT);
+	address = g_unix_socket_address_new (path);
+	connection = g_socket_client_connect (client,
+										  G_SOCKET_CONNECTABLE (address),
+										  NULL, NULL);
+	g_object_unref (address);
+	g_object_unref (client);
+	g_free (path);
+
+	if (connection == NULL)
+		return FALSE;
+
+	command = g_strdup_printf ("%s %s\n",
+							   everywhere ? "layout-all" : "layout",
+							   layout_name);
+	out = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+	in = g_data_input_stream_new (
+			g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+
+	reply = NULL;
+	if (g_output_stream_write_all (out, command, strlen (command),
+								   NULL, NULL, NULL))
+		reply = g_data_input_stream_read_line (in, NULL, NULL, NULL);
+
+	g_free (command);
+	g_object_unref (in);
+	g_object_unref (connection);
+
+	/* The daemon went away, eg. it is shutting down */
+	if (reply == NULL)
+		return FALSE;
+
+	if (round_trip)
+		*round_trip = g_get_monotonic_time () - start;
+
+	if (g_str_has_prefix (reply, "error "))
+		g_set_error (error, WW_ERROR, WW_ERROR_DAEMON,
+					 "%s", reply + strlen ("error "));
+
+	g_free (reply);
+
+	return TRUE;
+}
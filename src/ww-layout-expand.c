@@ -29,70 +29,55 @@
 /**
  * ww_layout_expand
  * @screen: The screen to work on
- * @windows: A list of all windows on the @screen
+ * @snapshot: The windows and struts on the @screen
  * @active: The currently active window
+ * @plan: The plan to write the new geometry to
  * @error: %GError to set on failure
  *
- * A %WwLayoutHandler expanding @active in all directions without it
- * overlapping any windows it doesn't already.
+ * A %WwLayoutHandler expanding @active to the largest free rectangle
+ * around it, without overlapping any windows it doesn't already, panels,
+ * or leaving its monitor.
  */
 void
 ww_layout_expand (WnckScreen	*screen,
-				  GList			*windows,
-				  GList			*struts,
+				  WwSnapshot	*snapshot,
 				  WnckWindow	*active,
+				  WwPlan		*plan,
 				  GError		**error)
 {
-	GList *next;
-	WnckWindow *win;
-	int x, y, w, h;				/* coords of active */
-	int wx, wy, ww, wh;			/* coords of window(s) to compare to */
-	int bx, by, br, bb;			/* coord bounds x, y, top, bottom */
+	WwSnapshot		*expand_snapshot;
+	WwWindowDesc	desc;
+	guint			i;
 	
-	/* We can ignore the struts because the window manager should make
-	 * sure we don't expand over them
-	 */
-
-	wnck_window_get_geometry (active, &x, &y, &w, &h);
-	bx = 0;
-	by = 0;
-	br = wnck_screen_get_width (screen);
-	bb = wnck_screen_get_height (screen);
-
+	if (active == NULL)
+		return;
 	
-	for (next = windows; next; next = next->next)
-	{	
-		win = WNCK_WINDOW (next->data);
-		
-		if (wnck_window_is_active (win))
-			continue;
-		
-		wnck_window_get_geometry (win, &wx, &wy, &ww, &wh);
-		
-		/* Expand left */
-		if (x > wx+ww) {
-			bx = MAX (bx, wx+ww);
-		}
-		
-		/* Expand right */
-		if (x + w < wx) {
-			br = MIN (br, wx);
-		}
-		
-		/* Expand up */
-		if (y > wy + wh) {
-			by = MAX (by, wy + wh);
-		}
-		
-		/* Expand down */
-		if (y + h < wy) {
-			bb = MIN (bb, wy);
+	for (i = 0; i < snapshot->windows->len; i++)
+	{
+		if (g_array_index (snapshot->windows, WwWindowDesc, i).data == active)
+		{
+			ww_apply_engine_active (ww_engine_layout_expand, snapshot, plan);
+			return;
 		}
 	}
 	
-	g_debug ("Expanding window to (%d, %d) @ %dx%d", bx, by, br - bx, bb - by);
+	/* The active window has been filtered out, eg. because it is maximized */
+	expand_snapshot = ww_snapshot_new ();
+	expand_snapshot->screen = snapshot->screen;
+	expand_snapshot->workarea = snapshot->workarea;
+	g_array_append_vals (expand_snapshot->monitors, snapshot->monitors->data,
+						 snapshot->monitors->len);
+	
+	ww_describe_window (active, NULL, &desc);
+	desc.flags |= WW_WINDOW_ACTIVE;
+	desc.monitor = ww_engine_find_monitor (
+						(const WwMonitor *) snapshot->monitors->data,
+						snapshot->monitors->len, &desc.geometry);
+	g_array_append_val (expand_snapshot->windows, desc);
+	g_array_append_vals (expand_snapshot->windows, snapshot->windows->data,
+						 snapshot->windows->len);
+	
+	ww_apply_engine_active (ww_engine_layout_expand, expand_snapshot, plan);
 	
-	wnck_window_set_geometry (active, WNCK_WINDOW_GRAVITY_STATIC,
-							  WW_MOVERESIZE_FLAGS, 
-							  bx, by, br - bx, bb - by);
+	ww_snapshot_free (expand_snapshot);
 }
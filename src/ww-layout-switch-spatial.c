@@ -24,56 +24,56 @@
 
 void
 ww_layout_switch_spatial_left(WnckScreen	*screen,
-				GList		*windows,
-				GList		*struts,
+				WwSnapshot	*snapshot,
 				WnckWindow	*active,
+				WwPlan		*plan,
 				GError		**error)
 {
 	WnckWindow *neighbour;
 
-	neighbour = ww_find_neighbour (screen, windows, active, LEFT);
-	neighbour ? wnck_window_activate (neighbour, ww_get_event_time()) : 
+	neighbour = ww_model_get_neighbour (active, LEFT);
+	neighbour ? ww_activate_window (neighbour) : 
 				g_debug ("Unable to find left neighbour");
 }
 
 void
 ww_layout_switch_spatial_right(WnckScreen	*screen,
-				GList		*windows,
-				GList		*struts,
+				WwSnapshot	*snapshot,
 				WnckWindow	*active,
+				WwPlan		*plan,
 				GError		**error)
 {
 	WnckWindow *neighbour;
 
-	neighbour = ww_find_neighbour (screen, windows, active, RIGHT);
-	neighbour ? wnck_window_activate (neighbour, ww_get_event_time()) : 
+	neighbour = ww_model_get_neighbour (active, RIGHT);
+	neighbour ? ww_activate_window (neighbour) : 
 				g_debug ("Unable to find right neighbour");
 }
 
 void
 ww_layout_switch_spatial_up(WnckScreen	*screen,
-				GList		*windows,
-				GList		*struts,
+				WwSnapshot	*snapshot,
 				WnckWindow	*active,
+				WwPlan		*plan,
 				GError		**error)
 {
 	WnckWindow *neighbour;
 
-	neighbour = ww_find_neighbour (screen, windows, active, UP);
-	neighbour ? wnck_window_activate (neighbour, ww_get_event_time()) : 
+	neighbour = ww_model_get_neighbour (active, UP);
+	neighbour ? ww_activate_window (neighbour) : 
 				g_debug ("Unable to find upper neighbour");
 }
 
 void
 ww_layout_switch_spatial_down(WnckScreen	*screen,
-				GList		*windows,
-				GList		*struts,
+				WwSnapshot	*snapshot,
 				WnckWindow	*active,
+				WwPlan		*plan,
 				GError		**error)
 {
 	WnckWindow *neighbour;
 
-	neighbour = ww_find_neighbour (screen, windows, active, DOWN);
-	neighbour ? wnck_window_activate (neighbour, ww_get_event_time()) : 
+	neighbour = ww_model_get_neighbour (active, DOWN);
+	neighbour ? ww_activate_window (neighbour) : 
 				g_debug ("Unable to find bottom neighbour");
 }
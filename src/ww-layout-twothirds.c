@@ -28,78 +28,23 @@
 /**
  * ww_layout_twothirds
  * @screen: The screen to work on
- * @windows: A list of all windows on the @screen
+ * @snapshot: The windows and struts on the @screen
  * @active: The currently active window
+ * @plan: The plan to write the new geometries to
  * @error: %GError to set on failure
  *
- * A %WwLayoutHandler resizing the active window to 2/3 of the screen
+ * A %WwLayoutHandler resizing the active window to 2/3 of its monitor
  */
 void
 ww_layout_twothirds (WnckScreen	*screen,
-				GList		*windows,
-				GList		*struts,
+				WwSnapshot	*snapshot,
 				WnckWindow	*active,
+				WwPlan		*plan,
 				GError		**error)
 {
-	GList	*next;
-	int		dim, row;
-	int		r_cell_w, r_cell_h;
-	int		edge_l, edge_t, edge_b, edge_r;
-	int		lg_h, lg_w, rg_h, rg_w;
-	
 	g_return_if_fail (WNCK_IS_SCREEN(screen));
-	if (g_list_length(windows) == 0)
+	if (snapshot->windows->len == 0)
 		return;
 	
-	ww_calc_bounds (screen, struts, &edge_l, &edge_t, &edge_r, &edge_b);
-	
-	lg_w = (edge_r - edge_l ) / 3 * 2;
-	rg_w = (edge_r - edge_l) - lg_w;
-
-	lg_h = rg_h = edge_b - edge_t;
-
-	dim = g_list_length(windows);
-
-	/* If there is only one window, resize it to fullscreen and exit */
-	if ( dim == 1 ) {
-		wnck_window_set_geometry (windows->data,
-								  WNCK_WINDOW_GRAVITY_STATIC,
-								  WW_MOVERESIZE_FLAGS, 
-								  edge_l, edge_t,
-								  edge_r - edge_l,
-								  edge_b - edge_t);
-		return;
-	}
-
-	dim -= 1;
-
-	/* If there is no active window, do nothing */
-	if (active == NULL
-	    || wnck_window_is_skip_tasklist (active)) {
-		g_debug ("No active window");
-		return;
-	}
-
-	r_cell_w = rg_w;
-	r_cell_h = rg_h / dim;
-
-	row = 0;
-	for (next = windows; next; next = next->next) 
-	{
-		if (wnck_window_is_active (next->data) == TRUE) 
-		{
-			wnck_window_set_geometry (next->data,
-									  WNCK_WINDOW_GRAVITY_STATIC,
-									  WW_MOVERESIZE_FLAGS, 
-									  edge_l, edge_t , lg_w, lg_h);
-		} else {
-			wnck_window_set_geometry (next->data, 
-									  WNCK_WINDOW_GRAVITY_STATIC,
-									  WW_MOVERESIZE_FLAGS, 
-									  lg_w + edge_l, row*r_cell_h + edge_t,
-									  r_cell_w, r_cell_h);
-			row++;
-		}
-	}
+	ww_apply_engine_active (ww_engine_layout_twothirds, snapshot, plan);
 }
-
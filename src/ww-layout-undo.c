@@ -0,0 +1,42 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "winwrangler.h"
+
+/**
+ * ww_layout_undo
+ * @screen: The screen to work on
+ * @snapshot: The windows and struts on the @screen
+ * @active: The currently active window
+ * @plan: The plan to write the restored geometries to
+ * @error: %GError to set on failure
+ *
+ * A %WwLayoutHandler moving the windows back to where they were before the
+ * last layout
+ */
+void
+ww_layout_undo (WnckScreen	*screen,
+				WwSnapshot	*snapshot,
+				WnckWindow	*active,
+				WwPlan		*plan,
+				GError		**error)
+{
+	if (!ww_undo_pop (plan))
+		g_debug ("Nothing to undo");
+}
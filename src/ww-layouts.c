@@ -20,57 +20,367 @@
 #include "winwrangler.h"
 #include "ww-layouts.h"
 
+#include <string.h>
+#include <gmodule.h>
+
+/* The prefix of the groups in the user layouts file */
+#define WW_USER_LAYOUT_GROUP "Layout "
+
+/* The layouts built into winwrangler. Layouts shipped separately are loaded
+ * from modules, see ww_load_layout_modules() */
 static WwLayout layouts[] = {
 	{"expand",
 	 "Expand active window",
 	 "Expand the currently active window to fill all available space "
 	 "without overlapping any new windows",
 	 "<Ctrl><Super>1",
-	 ww_layout_expand},
+	 ww_layout_expand,
+	 ww_engine_layout_expand,
+	 WW_LAYOUT_IDEMPOTENT},
 	{"tile",
 	 "Tile all windows",
 	 "Tile all visible windows",
 	 "<Ctrl><Super>2",
-	 ww_layout_tile},
+	 ww_layout_tile,
+	 ww_engine_layout_tile,
+	 WW_LAYOUT_IDEMPOTENT | WW_LAYOUT_SUPERSEDES},
 	{"twothirds",
 	 "2/3 Layout",
 	 "Resize the active window to 2/3 of the screen",
 	 "<Ctrl><Super>3",
-	 ww_layout_twothirds},
+	 ww_layout_twothirds,
+	 ww_engine_layout_twothirds,
+	 WW_LAYOUT_IDEMPOTENT | WW_LAYOUT_SUPERSEDES},
 	{"activate_left",
 	 "Switch left",
 	 "Switch to the window to the left of the current one",
 	 "<Ctrl><Super>Left",
-	 ww_layout_switch_spatial_left},
+	 ww_layout_switch_spatial_left,
+	 NULL,
+	 WW_LAYOUT_NO_UNDO | WW_LAYOUT_NO_SNAPSHOT},
 	{"activate_right",
 	 "Switch right",
 	 "Switch to the window to the right of the current one",
 	 "<Ctrl><Super>Right",
-	 ww_layout_switch_spatial_right},
+	 ww_layout_switch_spatial_right,
+	 NULL,
+	 WW_LAYOUT_NO_UNDO | WW_LAYOUT_NO_SNAPSHOT},
 	{"activate_up",
 	 "Switch up",
 	 "Switch to the window above the current one",
 	 "<Ctrl><Super>Up",
-	 ww_layout_switch_spatial_up},
+	 ww_layout_switch_spatial_up,
+	 NULL,
+	 WW_LAYOUT_NO_UNDO | WW_LAYOUT_NO_SNAPSHOT},
 	{"activate_down",
 	 "Switch down",
 	 "Switch to the window below the current one",
 	 "<Ctrl><Super>Down",
-	 ww_layout_switch_spatial_down},
+	 ww_layout_switch_spatial_down,
+	 NULL,
+	 WW_LAYOUT_NO_UNDO | WW_LAYOUT_NO_SNAPSHOT},
+	{"undo",
+	 "Undo",
+	 "Move the windows back to where they were before the last layout",
+	 "<Ctrl><Super>z",
+	 ww_layout_undo,
+	 NULL,
+	 WW_LAYOUT_NO_UNDO},
 	{NULL}
 };
 
+/* The registry. The list keeps the registration order for menus and
+ * --layouts, the hash table maps layout names to the same WwLayouts */
+static GHashTable	*layout_index = NULL;
+static GList		*layout_list = NULL;
+static GList		*layout_list_tail = NULL;
+static guint		num_layouts = 0;
+
+static void
+ensure_registry (void)
+{
+	WwLayout	*layout;
+	
+	if (layout_index)
+		return;
+	
+	layout_index = g_hash_table_new (g_str_hash, g_str_equal);
+	
+	for (layout = layouts; layout->name != NULL; layout++)
+		ww_register_layout (layout);
+}
+
+/**
+ * ww_register_layout
+ * @layout: The layout to register
+ *
+ * Make a layout available by its name. The layout is not copied, it must
+ * stay valid for the lifetime of the process. A layout needs a handler or
+ * a compute function, see ww_apply_engine_full(). Only layouts with a
+ * handler may be flagged %WW_LAYOUT_NO_SNAPSHOT.
+ *
+ * Return value: %FALSE if a layout with the same name is already registered
+ */
+gboolean
+ww_register_layout (const WwLayout *layout)
+{
+	g_return_val_if_fail (layout != NULL, FALSE);
+	g_return_val_if_fail (layout->name != NULL, FALSE);
+	g_return_val_if_fail (layout->handler != NULL || layout->compute != NULL,
+						  FALSE);
+	g_return_val_if_fail (layout->handler != NULL ||
+						  !(layout->flags & WW_LAYOUT_NO_SNAPSHOT), FALSE);
+	
+	ensure_registry ();
+	
+	if (g_hash_table_lookup (layout_index, layout->name))
+	{
+		g_warning ("Layout '%s' is already registered", layout->name);
+		return FALSE;
+	}
+	
+	g_hash_table_insert (layout_index, (gpointer) layout->name,
+						 (gpointer) layout);
+	
+	/* Append in constant time */
+	if (layout_list_tail)
+	{
+		layout_list_tail = g_list_append (layout_list_tail, (gpointer) layout);
+		layout_list_tail = layout_list_tail->next;
+	}
+	else
+	{
+		layout_list = layout_list_tail = g_list_append (NULL, (gpointer) layout);
+	}
+	
+	num_layouts++;
+	
+	return TRUE;
+}
+
+static gboolean
+load_layout_module (const gchar *path)
+{
+	GModule					*module;
+	WwLayoutModuleInitFunc	init;
+	
+	module = g_module_open (path, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+	if (module == NULL)
+	{
+		g_warning ("Failed to load layout module: %s", g_module_error ());
+		return FALSE;
+	}
+	
+	if (!g_module_symbol (module, WW_LAYOUT_MODULE_INIT, (gpointer *) &init)
+		|| init == NULL)
+	{
+		g_warning ("Layout module %s has no " WW_LAYOUT_MODULE_INIT "()",
+				   path);
+		g_module_close (module);
+		return FALSE;
+	}
+	
+	/* The registered layouts point into the module, so it can never be
+	 * unloaded */
+	g_module_make_resident (module);
+	init ();
+	
+	g_debug ("Loaded layout module %s", path);
+	
+	return TRUE;
+}
+
+/**
+ * ww_load_layout_modules
+ * @dir: The directory to load the modules from
+ *
+ * Load every layout module in @dir. A layout module is a shared library
+ * exporting a %WwLayoutModuleInitFunc called ww_layout_module_init(), which
+ * calls ww_register_layout() for each of its layouts. A missing directory
+ * is not an error.
+ *
+ * Return value: The number of modules loaded
+ */
+guint
+ww_load_layout_modules (const gchar *dir)
+{
+	GDir		*gdir;
+	const gchar	*name;
+	gchar		*path;
+	guint		count;
+	
+	g_return_val_if_fail (dir != NULL, 0);
+	
+	ensure_registry ();
+	
+	if (!g_module_supported ())
+		return 0;
+	
+	gdir = g_dir_open (dir, 0, NULL);
+	if (gdir == NULL)
+	{
+		g_debug ("No layout modules in %s", dir);
+		return 0;
+	}
+	
+	count = 0;
+	while ((name = g_dir_read_name (gdir)) != NULL)
+	{
+		if (!g_str_has_suffix (name, "." G_MODULE_SUFFIX))
+			continue;
+		
+		path = g_build_filename (dir, name, NULL);
+		if (load_layout_module (path))
+			count++;
+		g_free (path);
+	}
+	
+	g_dir_close (gdir);
+	
+	return count;
+}
+
+static void
+free_user_layout (WwLayout *layout)
+{
+	g_free ((gchar *) layout->name);
+	g_free ((gchar *) layout->label);
+	g_free ((gchar *) layout->desc);
+	g_free ((gchar *) layout->default_hotkey);
+	ww_program_free ((WwProgram *) layout->data);
+	g_free (layout);
+}
+
+/* Compile one group of the layouts file into a WwLayout */
+static WwLayout*
+compile_user_layout (GKeyFile *file, const gchar *group, GError **error)
+{
+	WwLayout	*layout;
+	WwProgram	*program;
+	gchar		*name;
+	
+	name = g_strstrip (g_strdup (group + strlen (WW_USER_LAYOUT_GROUP)));
+	if (*name == '\0')
+	{
+		g_set_error (error, WW_ERROR, WW_ERROR_BAD_FORMAT,
+					 "Group '%s' has no layout name", group);
+		g_free (name);
+		return NULL;
+	}
+	
+	program = ww_program_compile (file, group, error);
+	if (program == NULL)
+	{
+		g_free (name);
+		return NULL;
+	}
+	
+	layout = g_new0 (WwLayout, 1);
+	layout->name = name;
+	layout->label = g_key_file_get_locale_string (file, group, "Label",
+												  NULL, NULL);
+	if (layout->label == NULL)
+		layout->label = g_strdup (name);
+	layout->desc = g_key_file_get_locale_string (file, group, "Description",
+												 NULL, NULL);
+	if (layout->desc == NULL)
+		layout->desc = g_strdup_printf ("User defined layout with %u slots",
+										ww_program_get_n_slots (program));
+	layout->default_hotkey = g_key_file_get_string (file, group, "Hotkey",
+													NULL);
+	layout->compute = ww_engine_layout_program;
+	layout->flags = WW_LAYOUT_IDEMPOTENT;
+	layout->data = program;
+	
+	return layout;
+}
+
+/**
+ * ww_load_user_layouts
+ * @path: The layouts file
+ *
+ * Compile the layouts defined in @path and register them. Each layout is a
+ * group called "Layout NAME", see ww-program.c for the keys. Layouts with
+ * errors are skipped with a warning, and a missing file is not an error.
+ *
+ * Return value: The number of layouts registered
+ */
+guint
+ww_load_user_layouts (const gchar *path)
+{
+	GKeyFile	*file;
+	GError		*error;
+	WwLayout	*layout;
+	gchar		**groups;
+	guint		i, count;
+	
+	g_return_val_if_fail (path != NULL, 0);
+	
+	ensure_registry ();
+	
+	file = g_key_file_new ();
+	error = NULL;
+	if (!g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, &error))
+	{
+		if (g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("No user layouts in %s", path);
+		else
+			g_warning ("Failed to read %s: %s", path, error->message);
+		g_error_free (error);
+		g_key_file_free (file);
+		return 0;
+	}
+	
+	count = 0;
+	groups = g_key_file_get_groups (file, NULL);
+	for (i = 0; groups[i]; i++)
+	{
+		if (!g_str_has_prefix (groups[i], WW_USER_LAYOUT_GROUP))
+		{
+			g_warning ("Unknown group '%s' in %s", groups[i], path);
+			continue;
+		}
+		
+		layout = compile_user_layout (file, groups[i], &error);
+		if (layout == NULL)
+		{
+			g_warning ("Skipping layout in %s: %s", path, error->message);
+			g_clear_error (&error);
+			continue;
+		}
+		
+		if (!ww_register_layout (layout))
+		{
+			free_user_layout (layout);
+			continue;
+		}
+		
+		g_debug ("Compiled layout '%s' with %u slots", layout->name,
+				 ww_program_get_n_slots (layout->data));
+		count++;
+	}
+	
+	g_strfreev (groups);
+	g_key_file_free (file);
+	
+	return count;
+}
+
 /**
  * ww_get_layouts
  *
- * Get a %NULL terminated array containing all known %WwLayout<!-- -->s
+ * Get all registered %WwLayout<!-- -->s, the built in ones first and then
+ * the ones from modules and the layouts file in the order they were
+ * registered
  *
- * Return value: An array containing all known WwLayouts
+ * Return value: A list of const WwLayouts owned by the registry. It must
+ *               not be modified or freed
  */
-const WwLayout *
+GList*
 ww_get_layouts (void)
 {
-	return layouts;
+	ensure_registry ();
+	return layout_list;
 }
 
 /**
@@ -84,17 +394,10 @@ ww_get_layouts (void)
 const WwLayout *
 ww_get_layout (const gchar * layout_name)
 {
-	WwLayout *layout;
-	
 	g_return_val_if_fail (layout_name != NULL, NULL);
 	
-	for (layout = layouts; layout->name != NULL; layout++)
-	{
-		if (g_str_equal (layout_name, layout->name))
-			return layout;
-	}
-	
-	return NULL;
+	ensure_registry ();
+	return g_hash_table_lookup (layout_index, layout_name);
 }
 
 /**
@@ -107,12 +410,6 @@ ww_get_layout (const gchar * layout_name)
 guint
 ww_get_num_layouts (void)
 {
-	WwLayout	*layout;
-	guint		count;
-	
-	count = 0;
-	for (layout = ww_get_layouts (); layout->name != NULL; layout++)
-		count++;
-	
-	return count;
+	ensure_registry ();
+	return num_layouts;
 }
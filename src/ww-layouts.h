@@ -22,9 +22,10 @@
 
 G_BEGIN_DECLS
 
-/* Macro to define a layout handler. Layout handlers should also be added 
- * to ww-layouts.c in the "layouts" array */
-#define WW_LAYOUT_IMPL(layout) void layout (WnckScreen *screen, GList *windows, GList *struts, WnckWindow *active, GError **error);
+/* Macro to define a layout handler. Built in layout handlers should also be
+ * added to ww-layouts.c in the "layouts" array, layout modules register
+ * theirs with ww_register_layout() */
+#define WW_LAYOUT_IMPL(layout) void layout (WnckScreen *screen, WwSnapshot *snapshot, WnckWindow *active, WwPlan *plan, GError **error);
 
 WW_LAYOUT_IMPL(ww_layout_expand)
 WW_LAYOUT_IMPL(ww_layout_tile)
@@ -33,6 +34,7 @@ WW_LAYOUT_IMPL(ww_layout_switch_spatial_left)
 WW_LAYOUT_IMPL(ww_layout_switch_spatial_right)
 WW_LAYOUT_IMPL(ww_layout_switch_spatial_up)
 WW_LAYOUT_IMPL(ww_layout_switch_spatial_down)
+WW_LAYOUT_IMPL(ww_layout_undo)
 
 G_END_DECLS
 
@@ -0,0 +1,538 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The window model keeps a ready-to-use view of the user windows and struts
+ * on the active workspace. It is kept current from the libwnck signals so
+ * that applying a layout never has to call wnck_screen_force_update().
+ *
+ * libwnck already mirrors the X state client side, so rebuilding the
+ * snapshot is cheap. The model only marks itself dirty when something
+ * relevant changes and reclassifies the windows on the next request, in a
+ * single pass that reuses the storage of the previous snapshot. The daemon
+ * refreshes the model from an idle callback instead, so the neighbour graph
+ * is already up to date when a switch hotkey is pressed.
+ */
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "winwrangler.h"
+
+/* Key used to mark windows we have already connected to */
+#define WW_MODEL_TRACKED "ww-model-tracked"
+
+static WnckScreen	*model_screen = NULL;
+static WwSnapshot	*model_snapshot = NULL;
+static WwSpatialIndex	*model_index = NULL;
+static WwNeighbourGraph	*model_graph = NULL;
+static WnckWindow	*model_predicted = NULL;
+static gboolean		model_dirty = TRUE;
+static gboolean		model_background = FALSE;
+static guint		model_refresh_id = 0;
+static Atom			atom_frame_extents = None;
+
+/* Move the active flag in the snapshot to @active */
+static void
+mark_active (WnckWindow *active)
+{
+	WwWindowDesc	*desc;
+	guint			i;
+
+	for (i = 0; i < model_snapshot->windows->len; i++)
+	{
+		desc = &g_array_index (model_snapshot->windows, WwWindowDesc, i);
+		if (desc->data == active)
+			desc->flags |= WW_WINDOW_ACTIVE;
+		else
+			desc->flags &= ~WW_WINDOW_ACTIVE;
+	}
+}
+
+static void ww_model_refresh (void);
+
+static gboolean
+on_refresh_idle (gpointer data)
+{
+	model_refresh_id = 0;
+	ww_model_refresh ();
+
+	return FALSE;
+}
+
+/* Refresh on the next request, or as soon as the daemon is idle */
+static void
+mark_dirty (void)
+{
+	model_dirty = TRUE;
+
+	if (model_background && !model_refresh_id)
+		model_refresh_id = g_idle_add (on_refresh_idle, NULL);
+}
+
+static void
+on_window_changed (WnckWindow *window, gpointer data)
+{
+	mark_dirty ();
+}
+
+static void
+on_window_state_changed (WnckWindow			*window,
+						 WnckWindowState	changed_mask,
+						 WnckWindowState	new_state,
+						 gpointer			data)
+{
+	mark_dirty ();
+}
+
+static void
+track_window (WnckWindow *window)
+{
+	if (g_object_get_data (G_OBJECT (window), WW_MODEL_TRACKED))
+		return;
+
+	g_object_set_data (G_OBJECT (window), WW_MODEL_TRACKED,
+					   GINT_TO_POINTER (TRUE));
+
+	g_signal_connect (window, "geometry-changed",
+					  G_CALLBACK (on_window_changed), NULL);
+	g_signal_connect (window, "workspace-changed",
+					  G_CALLBACK (on_window_changed), NULL);
+	g_signal_connect (window, "state-changed",
+					  G_CALLBACK (on_window_state_changed), NULL);
+}
+
+static void
+on_window_opened (WnckScreen *screen, WnckWindow *window, gpointer data)
+{
+	track_window (window);
+	mark_dirty ();
+}
+
+static void
+on_window_closed (WnckScreen *screen, WnckWindow *window, gpointer data)
+{
+	if (window == model_predicted)
+		model_predicted = NULL;
+
+	/* The snapshot may hold the window, which is about to be destroyed */
+	ww_snapshot_reset (model_snapshot);
+	ww_spatial_index_clear (model_index);
+	ww_neighbour_graph_remove (model_graph, window);
+	mark_dirty ();
+}
+
+static void
+on_screen_changed (WnckScreen *screen, gpointer data)
+{
+	mark_dirty ();
+}
+
+static void
+on_workspace_changed (WnckScreen	*screen,
+					  WnckWorkspace	*previous,
+					  gpointer		data)
+{
+	mark_dirty ();
+}
+
+static void
+on_active_window_changed (WnckScreen	*screen,
+						  WnckWindow	*previous,
+						  gpointer		data)
+{
+	/* The X server has caught up with any activation we predicted */
+	model_predicted = NULL;
+
+	if (model_dirty)
+		return;
+
+	/* Focus changes are frequent, so just move the flag */
+	mark_active (wnck_screen_get_active_window (screen));
+}
+
+/* GDK gets the monitors from XRandR and keeps them up to date */
+static void
+refresh_monitors (int workspace)
+{
+	GdkScreen		*gdk_screen;
+	GdkRectangle	rect;
+	WwMonitor		*monitor;
+	int				i, n_monitors;
+
+	gdk_screen = gdk_screen_get_default ();
+	n_monitors = gdk_screen_get_n_monitors (gdk_screen);
+
+	g_array_set_size (model_snapshot->monitors, n_monitors);
+	for (i = 0; i < n_monitors; i++)
+	{
+		monitor = &g_array_index (model_snapshot->monitors, WwMonitor, i);
+		gdk_screen_get_monitor_geometry (gdk_screen, i, &rect);
+		monitor->geometry.x = rect.x;
+		monitor->geometry.y = rect.y;
+		monitor->geometry.width = rect.width;
+		monitor->geometry.height = rect.height;
+		ww_workarea_get (workspace, i, &monitor->workarea);
+	}
+}
+
+static GdkFilterReturn
+on_x_event (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
+{
+	XEvent		*xevent;
+	WnckWindow	*window;
+
+	xevent = (XEvent *) gdk_xevent;
+
+	if (xevent->type != PropertyNotify)
+		return GDK_FILTER_CONTINUE;
+
+	/* libwnck doesn't tell us about changed size hints */
+	if (xevent->xproperty.atom == XA_WM_NORMAL_HINTS)
+	{
+		window = wnck_window_get (xevent->xproperty.window);
+		if (window)
+		{
+			ww_forget_size_hints (window);
+			mark_dirty ();
+		}
+	}
+
+	/* libwnck adjusts the geometry itself, but the size hints of the
+	 * snapshot include the extents */
+	else if (xevent->xproperty.atom == atom_frame_extents)
+	{
+		window = wnck_window_get (xevent->xproperty.window);
+		if (window)
+		{
+			ww_forget_frame_extents (window);
+			mark_dirty ();
+		}
+	}
+
+	return GDK_FILTER_CONTINUE;
+}
+
+static void
+on_monitors_changed (GdkScreen *screen, gpointer data)
+{
+	/* The windows have to be assigned to the new monitors */
+	mark_dirty ();
+}
+
+static void
+ww_model_refresh (void)
+{
+	WnckWorkspace	*current_ws;
+	WwWindowDesc	desc, *win;
+	GList			*next;
+	guint			i;
+	int				workspace;
+
+	current_ws = wnck_screen_get_active_workspace (model_screen);
+	workspace = current_ws ? wnck_workspace_get_number (current_ws)
+						   : WW_WORKSPACE_ALL;
+
+	/* The screen size isn't covered by any of the signals */
+	model_snapshot->screen.x = 0;
+	model_snapshot->screen.y = 0;
+	model_snapshot->screen.width = wnck_screen_get_width (model_screen);
+	model_snapshot->screen.height = wnck_screen_get_height (model_screen);
+
+	/* The workarea has its own cache */
+	ww_workarea_get (workspace, WW_MONITOR_ALL, &model_snapshot->workarea);
+	refresh_monitors (workspace);
+
+	if (!model_dirty)
+		return;
+
+	ww_snapshot_reset (model_snapshot);
+	for (next = wnck_screen_get_windows (model_screen); next; next = next->next)
+	{
+		ww_describe_window (WNCK_WINDOW (next->data), current_ws, &desc);
+		ww_snapshot_classify (model_snapshot, &desc, workspace);
+	}
+
+	/* The index rebuilds its tree lazily on the next lookup. The graph
+	 * only recomputes the neighbours of windows affected by a change */
+	ww_spatial_index_clear (model_index);
+	ww_neighbour_graph_begin_sync (model_graph);
+	for (i = 0; i < model_snapshot->windows->len; i++)
+	{
+		win = &g_array_index (model_snapshot->windows, WwWindowDesc, i);
+		ww_spatial_index_add (model_index,
+							  win->geometry.x + win->geometry.width/2,
+							  win->geometry.y + win->geometry.height/2,
+							  win->data);
+		ww_neighbour_graph_set (model_graph, win->data,
+								win->geometry.x + win->geometry.width/2,
+								win->geometry.y + win->geometry.height/2);
+	}
+	ww_neighbour_graph_end_sync (model_graph);
+
+	/* ww_describe_window() only knows the active window according to X */
+	if (model_predicted)
+		mark_active (model_predicted);
+
+	model_dirty = FALSE;
+
+	if (model_refresh_id)
+	{
+		g_source_remove (model_refresh_id);
+		model_refresh_id = 0;
+	}
+}
+
+/**
+ * ww_model_init
+ *
+ * Start tracking the default screen. This is the only place where a full
+ * round trip to the X server is made; from here on the model is updated from
+ * the libwnck signals. Calling this function more than once is harmless.
+ */
+void
+ww_model_init (void)
+{
+	GList	*next;
+
+	if (model_screen)
+		return;
+
+	model_screen = wnck_screen_get_default ();
+	model_snapshot = ww_snapshot_new ();
+	model_index = ww_spatial_index_new ();
+	model_graph = ww_neighbour_graph_new ();
+	atom_frame_extents = gdk_x11_get_xatom_by_name ("_NET_FRAME_EXTENTS");
+
+	g_signal_connect (model_screen, "window-opened",
+					  G_CALLBACK (on_window_opened), NULL);
+	g_signal_connect (model_screen, "window-closed",
+					  G_CALLBACK (on_window_closed), NULL);
+	g_signal_connect (model_screen, "active-window-changed",
+					  G_CALLBACK (on_active_window_changed), NULL);
+	g_signal_connect (model_screen, "active-workspace-changed",
+					  G_CALLBACK (on_workspace_changed), NULL);
+	g_signal_connect (model_screen, "viewports-changed",
+					  G_CALLBACK (on_screen_changed), NULL);
+	g_signal_connect (gdk_screen_get_default (), "monitors-changed",
+					  G_CALLBACK (on_monitors_changed), NULL);
+	gdk_window_add_filter (NULL, on_x_event, NULL);
+
+	wnck_screen_force_update (model_screen);
+	ww_workarea_init (model_screen);
+
+	/* Windows seen before we connected to "window-opened" */
+	for (next = wnck_screen_get_windows (model_screen); next; next = next->next)
+		track_window (WNCK_WINDOW (next->data));
+
+	model_dirty = TRUE;
+}
+
+/**
+ * ww_model_refresh_when_idle
+ *
+ * Refresh the model from an idle callback whenever it changes, instead of
+ * on the next request. The daemon calls this so that the snapshot, the
+ * spatial index and the neighbour graph are usually current by the time a
+ * hotkey is pressed, and ww_model_get_neighbour() never has to refresh.
+ */
+void
+ww_model_refresh_when_idle (void)
+{
+	ww_model_init ();
+
+	model_background = TRUE;
+	if (model_dirty)
+		mark_dirty ();
+}
+
+/**
+ * ww_model_get_screen
+ *
+ * Return value: The screen tracked by the model. Owned by libwnck
+ */
+WnckScreen*
+ww_model_get_screen (void)
+{
+	ww_model_init ();
+	return model_screen;
+}
+
+/**
+ * ww_model_get_snapshot
+ *
+ * Get the user windows and struts on the active workspace, classified by
+ * ww_snapshot_classify().
+ *
+ * Return value: A snapshot owned by the model. It must not be modified or
+ *               freed and is only valid until control returns to the main
+ *               loop
+ */
+WwSnapshot*
+ww_model_get_snapshot (void)
+{
+	ww_model_init ();
+	ww_model_refresh ();
+	return model_snapshot;
+}
+
+/**
+ * ww_model_get_active
+ *
+ * Get the active window. If a window has been activated with
+ * ww_model_set_predicted_active() and the X server hasn't reported the
+ * change yet, that window is returned.
+ *
+ * Return value: The currently active window or %NULL
+ */
+WnckWindow*
+ww_model_get_active (void)
+{
+	ww_model_init ();
+
+	if (model_predicted)
+		return model_predicted;
+
+	return wnck_screen_get_active_window (model_screen);
+}
+
+/**
+ * ww_model_set_predicted_active
+ * @window: The window that is about to become active
+ *
+ * Treat @window as the active window until the X server reports the next
+ * change of the active window. This lets layouts applied in quick
+ * succession build on each other without waiting for a round trip.
+ */
+void
+ww_model_set_predicted_active (WnckWindow *window)
+{
+	g_return_if_fail (WNCK_IS_WINDOW (window));
+
+	ww_model_init ();
+
+	model_predicted = window;
+	if (!model_dirty)
+		mark_active (window);
+}
+
+/**
+ * ww_model_get_spatial_index
+ *
+ * Get a spatial index over the centres of the windows in
+ * ww_model_get_snapshot(). The index is updated whenever a window moves.
+ *
+ * Return value: An index owned by the model
+ */
+WwSpatialIndex*
+ww_model_get_spatial_index (void)
+{
+	ww_model_init ();
+	ww_model_refresh ();
+	return model_index;
+}
+
+/**
+ * ww_model_get_neighbour
+ * @window: The window to start from
+ * @direction: The direction to look in
+ *
+ * Get the nearest window in @direction of @window, as ww_find_neighbour()
+ * would find it. The neighbours of the windows in ww_model_get_snapshot()
+ * are kept in a graph that is updated as windows change, so for those this
+ * is a table lookup.
+ *
+ * After ww_model_refresh_when_idle() the graph is used as it is. A window
+ * that moved since the daemon was last idle is found where it was before.
+ *
+ * Return value: The neighbouring window or %NULL
+ */
+WnckWindow*
+ww_model_get_neighbour (WnckWindow *window, WwDirection direction)
+{
+	gpointer	neighbour;
+
+	ww_model_init ();
+	if (!model_background)
+		ww_model_refresh ();
+
+	if (window &&
+		ww_neighbour_graph_lookup (model_graph, window, direction, &neighbour))
+		return neighbour;
+
+	/* The window isn't laid out, eg. because it is maximized */
+	return ww_find_neighbour (model_index, window, direction);
+}
+
+static const gchar *direction_names[] = { "left", "right", "up", "down" };
+
+static const gchar*
+describe_neighbour (gpointer window)
+{
+	return window ? wnck_window_get_name (window) : "-";
+}
+
+static void
+log_neighbours (gpointer		window,
+				int				center_x,
+				int				center_y,
+				gpointer const	*neighbours,
+				gpointer		data)
+{
+	gpointer	expected;
+	int			d;
+
+	g_debug ("'%s' (%d, %d): left '%s', right '%s', up '%s', down '%s'",
+			 wnck_window_get_name (window), center_x, center_y,
+			 describe_neighbour (neighbours[LEFT]),
+			 describe_neighbour (neighbours[RIGHT]),
+			 describe_neighbour (neighbours[UP]),
+			 describe_neighbour (neighbours[DOWN]));
+
+	/* Check the graph against a fresh search */
+	for (d = LEFT; d <= DOWN; d++)
+	{
+		expected = ww_spatial_index_find_neighbour (model_index,
+													center_x, center_y, d);
+		if (expected != neighbours[d])
+			g_debug ("  %s: the spatial index finds '%s'",
+					 direction_names[d], describe_neighbour (expected));
+	}
+}
+
+/**
+ * ww_model_log_neighbours
+ *
+ * Log the neighbour graph used by ww_model_get_neighbour() as debug
+ * messages, one window per line. Neighbours that differ from what a fresh
+ * search of the spatial index finds are logged too. Ties may legitimately
+ * differ, since the graph breaks them by the order windows were added to
+ * it.
+ */
+void
+ww_model_log_neighbours (void)
+{
+	ww_model_init ();
+	ww_model_refresh ();
+
+	g_debug ("Neighbour graph of %u windows:",
+			 ww_neighbour_graph_get_size (model_graph));
+	ww_neighbour_graph_foreach (model_graph, log_neighbours, NULL);
+}
@@ -0,0 +1,246 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A WwPlan collects the geometry changes a layout wants to make. Nothing is
+ * sent to the X server until ww_plan_commit() is called, at which point all
+ * windows already in place are skipped and the remaining requests are
+ * flushed in one go.
+ */
+
+#include "winwrangler.h"
+
+typedef struct
+{
+	WnckWindow	*window;
+	int			x, y, width, height;
+} WwPlanEntry;
+
+struct _WwPlan
+{
+	GArray		*entries;
+	GHashTable	*index;		/* maps windows to their entry index plus one */
+};
+
+/**
+ * ww_plan_new
+ *
+ * Return value: A new, empty, #WwPlan. Free it with ww_plan_free()
+ */
+WwPlan*
+ww_plan_new (void)
+{
+	WwPlan	*plan;
+
+	plan = g_new0 (WwPlan, 1);
+	plan->entries = g_array_new (FALSE, FALSE, sizeof (WwPlanEntry));
+	plan->index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	return plan;
+}
+
+/**
+ * ww_plan_free
+ * @plan: The plan to free
+ *
+ * Release all resources held by @plan. Uncommitted changes are discarded.
+ */
+void
+ww_plan_free (WwPlan *plan)
+{
+	g_return_if_fail (plan != NULL);
+
+	g_array_free (plan->entries, TRUE);
+	g_hash_table_destroy (plan->index);
+	g_free (plan);
+}
+
+/**
+ * ww_plan_set_geometry
+ * @plan: The plan to add the change to
+ * @window: The window to move and resize
+ * @x: Target x coordinate
+ * @y: Target y coordinate
+ * @width: Target width
+ * @height: Target height
+ *
+ * Schedule @window to be moved to the given rectangle when @plan is
+ * committed. Setting the geometry of the same window twice replaces the
+ * earlier target, which is found by a hash table lookup.
+ */
+void
+ww_plan_set_geometry (WwPlan		*plan,
+					  WnckWindow	*window,
+					  int			x,
+					  int			y,
+					  int			width,
+					  int			height)
+{
+	WwPlanEntry	*entry;
+	WwPlanEntry	new_entry;
+	guint		pos;
+
+	g_return_if_fail (plan != NULL);
+	g_return_if_fail (WNCK_IS_WINDOW (window));
+
+	pos = GPOINTER_TO_UINT (g_hash_table_lookup (plan->index, window));
+	if (pos > 0)
+	{
+		entry = &g_array_index (plan->entries, WwPlanEntry, pos - 1);
+		entry->x = x;
+		entry->y = y;
+		entry->width = width;
+		entry->height = height;
+		return;
+	}
+
+	new_entry.window = window;
+	new_entry.x = x;
+	new_entry.y = y;
+	new_entry.width = width;
+	new_entry.height = height;
+	g_array_append_val (plan->entries, new_entry);
+	g_hash_table_insert (plan->index, window,
+						 GUINT_TO_POINTER (plan->entries->len));
+}
+
+/**
+ * ww_plan_get_length
+ * @plan: The plan to inspect
+ *
+ * Return value: The number of windows with a planned geometry
+ */
+guint
+ww_plan_get_length (WwPlan *plan)
+{
+	g_return_val_if_fail (plan != NULL, 0);
+
+	return plan->entries->len;
+}
+
+/**
+ * ww_plan_get_geometry
+ * @plan: The plan to inspect
+ * @index: Index of the entry, less than ww_plan_get_length()
+ * @x: Return location for the target x coordinate or %NULL
+ * @y: Return location for the target y coordinate or %NULL
+ * @width: Return location for the target width or %NULL
+ * @height: Return location for the target height or %NULL
+ *
+ * Return value: The window of the @index<!-- -->th planned change
+ */
+WnckWindow*
+ww_plan_get_geometry (WwPlan	*plan,
+					  guint		index,
+					  int		*x,
+					  int		*y,
+					  int		*width,
+					  int		*height)
+{
+	WwPlanEntry	*entry;
+
+	g_return_val_if_fail (plan != NULL, NULL);
+	g_return_val_if_fail (index < plan->entries->len, NULL);
+
+	entry = &g_array_index (plan->entries, WwPlanEntry, index);
+
+	if (x) *x = entry->x;
+	if (y) *y = entry->y;
+	if (width) *width = entry->width;
+	if (height) *height = entry->height;
+
+	return entry->window;
+}
+
+/**
+ * ww_plan_print
+ * @plan: The plan to print
+ *
+ * Print all planned changes to stdout without applying them
+ */
+void
+ww_plan_print (WwPlan *plan)
+{
+	WwPlanEntry	*entry;
+	guint		i;
+
+	g_return_if_fail (plan != NULL);
+
+	for (i = 0; i < plan->entries->len; i++)
+	{
+		entry = &g_array_index (plan->entries, WwPlanEntry, i);
+		g_print ("0x%08lx (%d, %d) @ %dx%d  %s\n",
+				 wnck_window_get_xid (entry->window),
+				 entry->x, entry->y, entry->width, entry->height,
+				 wnck_window_get_name (entry->window));
+	}
+}
+
+/**
+ * ww_plan_commit
+ * @plan: The plan to apply
+ *
+ * Send all planned changes to the X server. Windows that are already at
+ * their target geometry are skipped, and the remaining requests are flushed
+ * together at the end. The plan is emptied afterwards. Call
+ * ww_settle_start() to make sure the windows get where they were sent.
+ *
+ * Return value: The number of windows that were actually reconfigured
+ */
+guint
+ww_plan_commit (WwPlan *plan)
+{
+	WwPlanEntry	*entry;
+	guint		i, committed;
+	int			x, y, w, h;
+
+	g_return_val_if_fail (plan != NULL, 0);
+
+	/* The old targets are moot once new requests go out */
+	ww_settle_reset ();
+
+	committed = 0;
+	for (i = 0; i < plan->entries->len; i++)
+	{
+		entry = &g_array_index (plan->entries, WwPlanEntry, i);
+
+		/* libwnck caches the geometry, so this is not a round trip */
+		wnck_window_get_geometry (entry->window, &x, &y, &w, &h);
+		if (x == entry->x && y == entry->y &&
+			w == entry->width && h == entry->height)
+			continue;
+
+		ww_window_set_geometry (entry->window, entry->x, entry->y,
+								entry->width, entry->height);
+		ww_settle_expect (entry->window, entry->x, entry->y,
+						  entry->width, entry->height);
+		committed++;
+	}
+
+	if (committed > 0)
+		gdk_display_flush (gdk_display_get_default ());
+
+	g_debug ("Committed %u of %u planned geometries",
+			 committed, plan->entries->len);
+
+	g_array_set_size (plan->entries, 0);
+	g_hash_table_remove_all (plan->index);
+
+	return committed;
+}
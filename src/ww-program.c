@@ -0,0 +1,663 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * User defined layouts. Each layout is a group of the layouts file, eg.
+ *
+ *   [Layout code]
+ *   Label=Editor and terminals
+ *   Hotkey=<Ctrl><Super>4
+ *   Split=columns (3: editor, 2: rows (terms, other))
+ *   Match-editor=active
+ *   Match-terms=class XTerm
+ *   Match-other=any
+ *
+ * The Split key divides the workarea into named slots. A split is either
+ * "columns" or "rows" of slots and further splits, each optionally
+ * preceded by its share of the split, which defaults to 1. For every slot
+ * a Match key holds the rule for the windows it takes: "active", "class"
+ * followed by the WM_CLASS class of the window, or "any". A window goes to
+ * the first slot in the split whose rule it matches, and windows matching
+ * no slot are left alone. Slots without windows give their share to the
+ * rest of the split, and the windows of a slot share it along its longer
+ * side.
+ *
+ * A layout is compiled once, into the nodes of the split in pre-order and
+ * the rules with the class names hashed, so running it is a few passes
+ * over flat arrays. ww_engine_layout_program() runs the program in the
+ * data member of its input, so a compiled layout is a WwLayout like any
+ * other.
+ */
+
+#include <string.h>
+
+#include "ww-program.h"
+
+/* How deep splits may be nested */
+#define WW_PROGRAM_MAX_DEPTH 16
+
+/* Shares are kept in thousandths, so they add up exactly */
+#define WW_PROGRAM_SHARE_UNIT 1000
+
+typedef enum
+{
+	WW_OP_COLUMNS,
+	WW_OP_ROWS,
+	WW_OP_SLOT
+} WwOpKind;
+
+typedef enum
+{
+	WW_RULE_ANY,
+	WW_RULE_ACTIVE,
+	WW_RULE_CLASS
+} WwRuleKind;
+
+typedef struct
+{
+	WwOpKind	kind;
+	int			parent;		/* the enclosing split, -1 for the root */
+	int			share;		/* of the parent, in WW_PROGRAM_SHARE_UNITs */
+	WwRuleKind	rule;		/* slots only */
+	guint		class_hash;	/* for WW_RULE_CLASS, as in WwWindowDesc */
+} WwOp;
+
+struct _WwProgram
+{
+	WwOp		*ops;		/* the nodes of the split in pre-order */
+	int			n_ops;
+	int			*slots;		/* the indices of the slots in @ops */
+	int			n_slots;
+};
+
+/* The state of a node while a program runs */
+typedef struct
+{
+	int			count;		/* windows in a slot */
+	int			next;		/* where the next window of a slot is sorted */
+	gint64		total;		/* shares of the children that have windows */
+	gint64		done;		/* shares of the children placed so far */
+	WwRect		rect;
+} WwOpState;
+
+typedef struct
+{
+	const gchar	*source;
+	const gchar	*pos;
+	const gchar	*group;
+	GArray		*ops;		/* of WwOp */
+	GPtrArray	*names;		/* slot name of each op, NULL for splits */
+	GError		**error;
+} WwParser;
+
+static gboolean parse_node (WwParser *parser, int parent, int share, int depth);
+
+static void
+parse_error (WwParser *parser, const gchar *format, ...)
+{
+	va_list	args;
+	gchar	*message;
+
+	va_start (args, format);
+	message = g_strdup_vprintf (format, args);
+	va_end (args);
+
+	g_set_error (parser->error, G_KEY_FILE_ERROR,
+				 G_KEY_FILE_ERROR_INVALID_VALUE,
+				 "Split of '%s', column %d: %s", parser->group,
+				 (int) (parser->pos - parser->source) + 1, message);
+	g_free (message);
+}
+
+static void
+skip_space (WwParser *parser)
+{
+	while (g_ascii_isspace (*parser->pos))
+		parser->pos++;
+}
+
+static gboolean
+is_name_char (gchar c)
+{
+	return g_ascii_isalnum (c) || c == '_' || c == '-';
+}
+
+static int
+add_op (WwParser *parser, WwOpKind kind, int parent, int share, gchar *name)
+{
+	WwOp	op;
+
+	memset (&op, 0, sizeof (op));
+	op.kind = kind;
+	op.parent = parent;
+	op.share = share;
+	g_array_append_val (parser->ops, op);
+	g_ptr_array_add (parser->names, name);
+
+	return parser->ops->len - 1;
+}
+
+static int
+find_slot (WwParser *parser, const gchar *name)
+{
+	guint	i;
+
+	for (i = 0; i < parser->names->len; i++)
+		if (g_strcmp0 (g_ptr_array_index (parser->names, i), name) == 0)
+			return i;
+
+	return -1;
+}
+
+/* An optional share followed by a node */
+static gboolean
+parse_item (WwParser *parser, int parent, int depth)
+{
+	gchar	*end;
+	double	share;
+
+	skip_space (parser);
+	if (!g_ascii_isdigit (*parser->pos) && *parser->pos != '.')
+		return parse_node (parser, parent, WW_PROGRAM_SHARE_UNIT, depth);
+
+	share = g_ascii_strtod (parser->pos, &end);
+	if (end == parser->pos || !(share * WW_PROGRAM_SHARE_UNIT >= 1) ||
+		share > 1000)
+	{
+		parse_error (parser, "expected a share between 0.001 and 1000");
+		return FALSE;
+	}
+	parser->pos = end;
+
+	skip_space (parser);
+	if (*parser->pos != ':')
+	{
+		parse_error (parser, "expected ':' after the share");
+		return FALSE;
+	}
+	parser->pos++;
+
+	return parse_node (parser, parent,
+					   (int) (share * WW_PROGRAM_SHARE_UNIT + 0.5), depth);
+}
+
+/* A slot name, or a split and its items */
+static gboolean
+parse_node (WwParser *parser, int parent, int share, int depth)
+{
+	const gchar	*start;
+	gchar		*name;
+	WwOpKind	kind;
+	int			index;
+
+	skip_space (parser);
+	start = parser->pos;
+	while (is_name_char (*parser->pos))
+		parser->pos++;
+
+	if (parser->pos == start)
+	{
+		parse_error (parser, "expected a slot name, columns or rows");
+		return FALSE;
+	}
+
+	name = g_strndup (start, parser->pos - start);
+	skip_space (parser);
+
+	if (strcmp (name, "columns") == 0 || strcmp (name, "rows") == 0)
+	{
+		kind = name[0] == 'c' ? WW_OP_COLUMNS : WW_OP_ROWS;
+		if (*parser->pos != '(')
+		{
+			parse_error (parser, "expected '(' after %s", name);
+			g_free (name);
+			return FALSE;
+		}
+		g_free (name);
+
+		if (depth >= WW_PROGRAM_MAX_DEPTH)
+		{
+			parse_error (parser, "splits nested too deep");
+			return FALSE;
+		}
+		parser->pos++;
+
+		index = add_op (parser, kind, parent, share, NULL);
+		for (;;)
+		{
+			if (!parse_item (parser, index, depth + 1))
+				return FALSE;
+			skip_space (parser);
+			if (*parser->pos != ',')
+				break;
+			parser->pos++;
+		}
+
+		if (*parser->pos != ')')
+		{
+			parse_error (parser, "expected ',' or ')'");
+			return FALSE;
+		}
+		parser->pos++;
+
+		return TRUE;
+	}
+
+	if (find_slot (parser, name) >= 0)
+	{
+		parse_error (parser, "slot '%s' is used twice", name);
+		g_free (name);
+		return FALSE;
+	}
+
+	add_op (parser, WW_OP_SLOT, parent, share, name);
+
+	return TRUE;
+}
+
+static gboolean
+parse_rule (const gchar *group,
+			const gchar *slot,
+			gchar		*rule,
+			WwOp		*op,
+			GError		**error)
+{
+	gchar	*class_name;
+
+	g_strstrip (rule);
+
+	if (strcmp (rule, "any") == 0)
+	{
+		op->rule = WW_RULE_ANY;
+		return TRUE;
+	}
+
+	if (strcmp (rule, "active") == 0)
+	{
+		op->rule = WW_RULE_ACTIVE;
+		return TRUE;
+	}
+
+	if (g_str_has_prefix (rule, "class") && g_ascii_isspace (rule[5]))
+	{
+		class_name = g_strstrip (rule + 5);
+		op->rule = WW_RULE_CLASS;
+		op->class_hash = g_str_hash (class_name);
+		return TRUE;
+	}
+
+	g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+				 "Rule of slot '%s' in '%s' is not 'active', 'any' or "
+				 "'class NAME': %s", slot, group, rule);
+
+	return FALSE;
+}
+
+/* Read the Match key of every slot, and make sure there are no others */
+static gboolean
+compile_rules (GKeyFile		*file,
+			   const gchar	*group,
+			   WwParser		*parser,
+			   GError		**error)
+{
+	gchar		**keys, *key, *rule;
+	const gchar	*name;
+	gboolean	ok;
+	guint		i;
+
+	ok = TRUE;
+	for (i = 0; i < parser->ops->len && ok; i++)
+	{
+		name = g_ptr_array_index (parser->names, i);
+		if (name == NULL)
+			continue;
+
+		key = g_strconcat ("Match-", name, NULL);
+		rule = g_key_file_get_string (file, group, key, error);
+		ok = rule != NULL &&
+			 parse_rule (group, name, rule,
+						 &g_array_index (parser->ops, WwOp, i), error);
+		g_free (rule);
+		g_free (key);
+	}
+
+	keys = g_key_file_get_keys (file, group, NULL, NULL);
+	for (i = 0; ok && keys && keys[i]; i++)
+	{
+		if (g_str_has_prefix (keys[i], "Match-") &&
+			find_slot (parser, keys[i] + strlen ("Match-")) < 0)
+		{
+			g_set_error (error, G_KEY_FILE_ERROR,
+						 G_KEY_FILE_ERROR_INVALID_VALUE,
+						 "%s in '%s' has no slot in the split",
+						 keys[i], group);
+			ok = FALSE;
+		}
+	}
+	g_strfreev (keys);
+
+	return ok;
+}
+
+/**
+ * ww_program_compile
+ * @file: The layouts file
+ * @group: The group of @file holding the layout
+ * @error: Return location for a #GError or %NULL
+ *
+ * Compile the Split and Match keys of @group into a program for
+ * ww_program_run(). The other keys of the group are left to the caller.
+ * Errors are in the %G_KEY_FILE_ERROR domain.
+ *
+ * Return value: A new #WwProgram, or %NULL if the layout is invalid
+ */
+WwProgram*
+ww_program_compile (GKeyFile *file, const gchar *group, GError **error)
+{
+	WwProgram	*program;
+	WwParser	parser;
+	gchar		*split;
+	int			i, k;
+
+	g_return_val_if_fail (file != NULL, NULL);
+	g_return_val_if_fail (group != NULL, NULL);
+
+	split = g_key_file_get_string (file, group, "Split", error);
+	if (split == NULL)
+		return NULL;
+
+	parser.source = parser.pos = split;
+	parser.group = group;
+	parser.ops = g_array_new (FALSE, FALSE, sizeof (WwOp));
+	parser.names = g_ptr_array_new ();
+	parser.error = error;
+
+	program = NULL;
+	if (parse_node (&parser, -1, WW_PROGRAM_SHARE_UNIT, 0))
+	{
+		skip_space (&parser);
+		if (*parser.pos != '\0')
+			parse_error (&parser, "unexpected text after the split");
+		else if (compile_rules (file, group, &parser, error))
+			program = g_new0 (WwProgram, 1);
+	}
+
+	if (program)
+	{
+		program->n_ops = parser.ops->len;
+		program->ops = (WwOp *) g_array_free (parser.ops, FALSE);
+
+		for (i = 0; i < program->n_ops; i++)
+			if (program->ops[i].kind == WW_OP_SLOT)
+				program->n_slots++;
+
+		program->slots = g_new (int, program->n_slots);
+		for (i = 0, k = 0; i < program->n_ops; i++)
+			if (program->ops[i].kind == WW_OP_SLOT)
+				program->slots[k++] = i;
+	}
+	else
+		g_array_free (parser.ops, TRUE);
+
+	for (i = 0; i < (int) parser.names->len; i++)
+		g_free (g_ptr_array_index (parser.names, i));
+	g_ptr_array_free (parser.names, TRUE);
+	g_free (split);
+
+	return program;
+}
+
+/**
+ * ww_program_free
+ * @program: The program to free
+ *
+ * Free a program returned by ww_program_compile().
+ */
+void
+ww_program_free (WwProgram *program)
+{
+	if (program == NULL)
+		return;
+
+	g_free (program->ops);
+	g_free (program->slots);
+	g_free (program);
+}
+
+/**
+ * ww_program_get_n_slots
+ * @program: A compiled layout
+ *
+ * Return value: The number of slots in the split of @program
+ */
+guint
+ww_program_get_n_slots (const WwProgram *program)
+{
+	g_return_val_if_fail (program != NULL, 0);
+
+	return program->n_slots;
+}
+
+static gboolean
+rule_matches (const WwOp *op, const WwWindowDesc *window)
+{
+	switch (op->rule)
+	{
+		case WW_RULE_ACTIVE:
+			return (window->flags & WW_WINDOW_ACTIVE) != 0;
+		case WW_RULE_CLASS:
+			return window->class_hash == op->class_hash;
+		default:
+			return TRUE;
+	}
+}
+
+static gboolean
+is_occupied (const WwOp *op, const WwOpState *state)
+{
+	return op->kind == WW_OP_SLOT ? state->count > 0 : state->total > 0;
+}
+
+/* Share the rectangle of a slot among its windows along its longer side,
+ * respecting their size hints */
+static void
+place_slot (const WwEngineInput	*input,
+			const WwRect		*rect,
+			const int			*windows,
+			int					n,
+			WwSizeHints			*hints,
+			int					*starts,
+			int					*sizes,
+			WwRect				*cells)
+{
+	WwSizeHints	cross;
+	WwRect		*cell;
+	gboolean	vertical;
+	int			i, across;
+
+	vertical = rect->height > rect->width;
+	for (i = 0; i < n; i++)
+		ww_engine_get_size_hints (&input->windows[windows[i]], vertical,
+								  &hints[i]);
+	ww_engine_allocate (vertical ? rect->height : rect->width, hints, n,
+						starts, sizes);
+
+	for (i = 0; i < n; i++)
+	{
+		cell = &cells[windows[i]];
+		ww_engine_get_size_hints (&input->windows[windows[i]], !vertical,
+								  &cross);
+		across = ww_engine_fit_size (&cross,
+									 vertical ? rect->width : rect->height);
+
+		if (vertical)
+		{
+			cell->x = rect->x;
+			cell->y = rect->y + starts[i];
+			cell->width = across;
+			cell->height = sizes[i];
+		}
+		else
+		{
+			cell->x = rect->x + starts[i];
+			cell->y = rect->y;
+			cell->width = sizes[i];
+			cell->height = across;
+		}
+	}
+}
+
+/**
+ * ww_program_run
+ * @program: A compiled layout
+ * @input: The windows to lay out
+ * @cells: Return location for one rectangle per window of @input
+ *
+ * Lay out the windows of @input in the slots of @program. Windows matching
+ * no slot keep their geometry.
+ *
+ * Return value: %FALSE if no window matches any slot
+ */
+gboolean
+ww_program_run (const WwProgram		*program,
+				const WwEngineInput	*input,
+				WwRect				*cells)
+{
+	const WwOp	*op;
+	WwOpState	*state, *parent;
+	WwSizeHints	*hints;
+	int			*slot_of, *order, *starts, *sizes;
+	int			i, o, s, n, placed, length, a, b;
+	gboolean	across;
+
+	g_return_val_if_fail (program != NULL, FALSE);
+
+	n = input->n_windows;
+	if (n == 0)
+		return FALSE;
+
+	state = g_new0 (WwOpState, program->n_ops);
+	slot_of = g_new (int, 4 * n);
+	order = slot_of + n;
+	starts = order + n;
+	sizes = starts + n;
+	hints = g_new (WwSizeHints, n);
+
+	/* Each window goes to the first slot whose rule it matches */
+	placed = 0;
+	for (i = 0; i < n; i++)
+	{
+		cells[i] = input->windows[i].geometry;
+		slot_of[i] = -1;
+		for (s = 0; s < program->n_slots; s++)
+		{
+			o = program->slots[s];
+			if (rule_matches (&program->ops[o], &input->windows[i]))
+			{
+				slot_of[i] = o;
+				state[o].count++;
+				placed++;
+				break;
+			}
+		}
+	}
+
+	if (placed > 0)
+	{
+		/* Children come after their parent, so going backwards adds up
+		 * the shares of the nodes with windows before their parent is
+		 * looked at */
+		for (o = program->n_ops - 1; o > 0; o--)
+		{
+			op = &program->ops[o];
+			if (is_occupied (op, &state[o]))
+				state[op->parent].total += op->share;
+		}
+
+		/* Going forwards cuts each node out of its parent */
+		ww_engine_get_bounds (input, &state[0].rect);
+		for (o = 1; o < program->n_ops; o++)
+		{
+			op = &program->ops[o];
+			if (!is_occupied (op, &state[o]))
+				continue;
+
+			parent = &state[op->parent];
+			across = program->ops[op->parent].kind == WW_OP_COLUMNS;
+			length = across ? parent->rect.width : parent->rect.height;
+			a = length * parent->done / parent->total;
+			parent->done += op->share;
+			b = length * parent->done / parent->total;
+
+			state[o].rect = parent->rect;
+			if (across)
+			{
+				state[o].rect.x += a;
+				state[o].rect.width = b - a;
+			}
+			else
+			{
+				state[o].rect.y += a;
+				state[o].rect.height = b - a;
+			}
+		}
+
+		/* Sort the windows by slot */
+		for (o = 0, i = 0; o < program->n_ops; o++)
+		{
+			state[o].next = i;
+			i += state[o].count;
+		}
+		for (i = 0; i < n; i++)
+			if (slot_of[i] >= 0)
+				order[state[slot_of[i]].next++] = i;
+
+		for (s = 0; s < program->n_slots; s++)
+		{
+			o = program->slots[s];
+			if (state[o].count > 0)
+				place_slot (input, &state[o].rect,
+							order + state[o].next - state[o].count,
+							state[o].count, hints, starts, sizes, cells);
+		}
+	}
+
+	g_free (hints);
+	g_free (slot_of);
+	g_free (state);
+
+	return placed > 0;
+}
+
+/**
+ * ww_engine_layout_program
+ * @input: The windows to lay out. The data member is the #WwProgram
+ * @cells: Return location for one rectangle per window of @input
+ *
+ * The %WwEngineFunc of user defined layouts, see ww_program_run().
+ *
+ * Return value: %FALSE if no window matches any slot
+ */
+gboolean
+ww_engine_layout_program (const WwEngineInput *input, WwRect *cells)
+{
+	g_return_val_if_fail (input->data != NULL, FALSE);
+
+	return ww_program_run (input->data, input, cells);
+}
@@ -0,0 +1,49 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WW_PROGRAM_H_
+#define _WW_PROGRAM_H_
+
+#include <glib.h>
+
+#include "ww-engine.h"
+
+G_BEGIN_DECLS
+
+/* A user defined layout, compiled from a group of the layouts file */
+typedef struct _WwProgram WwProgram;
+
+WwProgram*			ww_program_compile			(GKeyFile *file,
+												 const gchar *group,
+												 GError **error);
+
+void				ww_program_free				(WwProgram *program);
+
+guint				ww_program_get_n_slots		(const WwProgram *program);
+
+gboolean			ww_program_run				(const WwProgram *program,
+												 const WwEngineInput *input,
+												 WwRect *cells);
+
+gboolean			ww_engine_layout_program	(const WwEngineInput *input,
+												 WwRect *cells);
+
+G_END_DECLS
+
+#endif /* _WW_PROGRAM_H_ */
@@ -0,0 +1,383 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The window manager doesn't always give a window the geometry it was asked
+ * for. It adds decorations, rounds to size increments and enforces minimum
+ * sizes, so the windows of a layout may end up overlapping or leaving gaps.
+ *
+ * After a plan is committed the settle phase watches the geometry libwnck
+ * reports for each window from its ConfigureNotify events. Once every
+ * window has answered, those that missed their target get one corrective
+ * request, offset by how far they were off. A window that doesn't answer
+ * within WW_SETTLE_TIMEOUT is given up on, so a settle never takes more
+ * than two timeouts.
+ */
+
+#include "winwrangler.h"
+
+/* Passes including the first request, so at most one correction */
+#define WW_SETTLE_MAX_PASSES 2
+
+/* How long a pass waits for the windows to answer, in milliseconds */
+#define WW_SETTLE_TIMEOUT 250
+
+/* How long to wait for further events once all windows have answered, as
+ * some window managers move and resize in separate steps */
+#define WW_SETTLE_QUIET 20
+
+typedef struct
+{
+	WnckWindow	*window;
+	WwRect		target;
+	gulong		handler;
+	gboolean	answered;	/* got a new geometry since the last request */
+} WwSettleEntry;
+
+static GArray		*settle_entries = NULL;	/* of WwSettleEntry */
+static gchar		*settle_name = NULL;
+static guint		settle_pass = 0;		/* 0 if not settling */
+static gint64		settle_start = 0;
+static guint		settle_n_windows = 0;
+static guint		settle_given_up = 0;	/* windows that never answered */
+static guint		settle_timeout = 0;
+static guint		settle_quiet = 0;
+static gulong		settle_closed_handler = 0;
+static GMainLoop	*settle_loop = NULL;
+
+static gboolean on_timeout (gpointer data);
+
+static gboolean
+is_on_target (WwSettleEntry *entry)
+{
+	int	x, y, w, h;
+
+	wnck_window_get_geometry (entry->window, &x, &y, &w, &h);
+
+	return x == entry->target.x && y == entry->target.y &&
+		   w == entry->target.width && h == entry->target.height;
+}
+
+static void
+remove_sources (void)
+{
+	if (settle_timeout)
+		g_source_remove (settle_timeout);
+	if (settle_quiet)
+		g_source_remove (settle_quiet);
+	settle_timeout = settle_quiet = 0;
+}
+
+static void
+forget_entry (guint index)
+{
+	WwSettleEntry	*entry;
+
+	entry = &g_array_index (settle_entries, WwSettleEntry, index);
+	if (entry->handler)
+		g_signal_handler_disconnect (entry->window, entry->handler);
+	g_array_remove_index_fast (settle_entries, index);
+}
+
+static void
+forget_entries (void)
+{
+	while (settle_entries && settle_entries->len > 0)
+		forget_entry (settle_entries->len - 1);
+}
+
+static void
+settle_finish (guint missed)
+{
+	g_debug ("Layout '%s' settled after %u pass%s, %u of %u windows off "
+			 "target", settle_name, settle_pass, settle_pass > 1 ? "es" : "",
+			 missed, settle_n_windows);
+
+	ww_stats_record (settle_name, WW_PHASE_SETTLE, settle_start);
+	ww_stats_count (WW_COUNTER_SETTLE_PASSES, settle_pass);
+	ww_stats_count (WW_COUNTER_UNSETTLED, missed);
+
+	remove_sources ();
+	forget_entries ();
+	settle_pass = 0;
+
+	if (settle_loop)
+		g_main_loop_quit (settle_loop);
+}
+
+/* Ask the windows that answered but missed their target to move by how
+ * far they were off. Returns the number of corrected windows */
+static guint
+correct_entries (void)
+{
+	WwSettleEntry	*entry;
+	guint			i, corrected;
+	int				x, y, w, h;
+
+	corrected = 0;
+	for (i = settle_entries->len; i-- > 0; )
+	{
+		entry = &g_array_index (settle_entries, WwSettleEntry, i);
+		if (!entry->answered || is_on_target (entry))
+		{
+			forget_entry (i);
+			continue;
+		}
+
+		wnck_window_get_geometry (entry->window, &x, &y, &w, &h);
+		g_debug ("Correcting '%s', asked for (%d, %d) @ %dx%d but got "
+				 "(%d, %d) @ %dx%d", wnck_window_get_name (entry->window),
+				 entry->target.x, entry->target.y,
+				 entry->target.width, entry->target.height, x, y, w, h);
+
+		ww_window_set_geometry (entry->window,
+								2 * entry->target.x - x,
+								2 * entry->target.y - y,
+								2 * entry->target.width - w,
+								2 * entry->target.height - h);
+		entry->answered = FALSE;
+		corrected++;
+	}
+
+	if (corrected > 0)
+		gdk_display_flush (gdk_display_get_default ());
+
+	return corrected;
+}
+
+/* End the current pass, either because all windows answered or because
+ * the time is up */
+static void
+settle_evaluate (void)
+{
+	WwSettleEntry	*entry;
+	guint			i, missed, corrected;
+
+	remove_sources ();
+
+	missed = 0;
+	for (i = 0; i < settle_entries->len; i++)
+	{
+		entry = &g_array_index (settle_entries, WwSettleEntry, i);
+		if (!is_on_target (entry))
+			missed++;
+	}
+
+	if (missed == 0 || settle_pass >= WW_SETTLE_MAX_PASSES)
+	{
+		settle_finish (missed + settle_given_up);
+		return;
+	}
+
+	/* A window that didn't answer will hardly do so for a second request,
+	 * so it is given up on right away */
+	corrected = correct_entries ();
+	ww_stats_count (WW_COUNTER_CORRECTIONS, corrected);
+	if (corrected == 0)
+	{
+		settle_finish (missed);
+		return;
+	}
+
+	settle_given_up = missed - corrected;
+	settle_pass++;
+	settle_timeout = g_timeout_add (WW_SETTLE_TIMEOUT, on_timeout, NULL);
+}
+
+static gboolean
+on_timeout (gpointer data)
+{
+	settle_timeout = 0;
+	settle_evaluate ();
+
+	return FALSE;
+}
+
+static gboolean
+on_quiet (gpointer data)
+{
+	settle_quiet = 0;
+	settle_evaluate ();
+
+	return FALSE;
+}
+
+static void
+on_geometry_changed (WnckWindow *window, gpointer data)
+{
+	WwSettleEntry	*entry;
+	guint			i;
+
+	entry = NULL;
+	for (i = 0; i < settle_entries->len; i++)
+	{
+		if (g_array_index (settle_entries, WwSettleEntry, i).window == window)
+			entry = &g_array_index (settle_entries, WwSettleEntry, i);
+	}
+	if (entry == NULL)
+		return;
+
+	entry->answered = TRUE;
+
+	for (i = 0; i < settle_entries->len; i++)
+	{
+		if (!g_array_index (settle_entries, WwSettleEntry, i).answered)
+			return;
+	}
+
+	/* Everybody answered, give them a moment for any further steps */
+	if (settle_quiet)
+		g_source_remove (settle_quiet);
+	settle_quiet = g_timeout_add (WW_SETTLE_QUIET, on_quiet, NULL);
+}
+
+static void
+on_window_closed (WnckScreen *screen, WnckWindow *window, gpointer data)
+{
+	guint	i;
+
+	if (settle_entries == NULL)
+		return;
+
+	for (i = 0; i < settle_entries->len; i++)
+	{
+		if (g_array_index (settle_entries, WwSettleEntry, i).window == window)
+		{
+			forget_entry (i);
+			break;
+		}
+	}
+
+	if (settle_pass > 0 && settle_entries->len == 0)
+		settle_finish (settle_given_up);
+}
+
+/**
+ * ww_settle_reset
+ *
+ * Stop watching the windows of the last commit. Called by ww_plan_commit()
+ * before sending new requests, which make the old targets moot.
+ */
+void
+ww_settle_reset (void)
+{
+	if (settle_pass > 0)
+		g_debug ("Layout '%s' superseded before it settled", settle_name);
+
+	remove_sources ();
+	forget_entries ();
+	settle_pass = 0;
+
+	if (settle_loop)
+		g_main_loop_quit (settle_loop);
+}
+
+/**
+ * ww_settle_expect
+ * @window: A window that was just asked to change its geometry
+ * @x: The requested x coordinate
+ * @y: The requested y coordinate
+ * @width: The requested width
+ * @height: The requested height
+ *
+ * Remember the geometry requested for @window, to be checked by the settle
+ * phase started with ww_settle_start().
+ */
+void
+ww_settle_expect (WnckWindow *window, int x, int y, int width, int height)
+{
+	WwSettleEntry	entry;
+
+	g_return_if_fail (WNCK_IS_WINDOW (window));
+
+	if (settle_entries == NULL)
+		settle_entries = g_array_new (FALSE, FALSE, sizeof (WwSettleEntry));
+
+	entry.window = window;
+	entry.target.x = x;
+	entry.target.y = y;
+	entry.target.width = width;
+	entry.target.height = height;
+	entry.handler = 0;
+	entry.answered = FALSE;
+	g_array_append_val (settle_entries, entry);
+}
+
+/**
+ * ww_settle_start
+ * @name: The name of the layout, for the statistics
+ *
+ * Start watching the windows of the last ww_plan_commit() until they have
+ * reached the requested geometry, correcting those that don't once. The
+ * settle phase runs from the main loop and is recorded as the
+ * %WW_PHASE_SETTLE of @name.
+ */
+void
+ww_settle_start (const gchar *name)
+{
+	WwSettleEntry	*entry;
+	guint			i;
+
+	g_return_if_fail (name != NULL);
+
+	if (settle_entries == NULL || settle_entries->len == 0 || settle_pass > 0)
+		return;
+
+	if (settle_closed_handler == 0)
+		settle_closed_handler = g_signal_connect (ww_model_get_screen (),
+												  "window-closed",
+												  G_CALLBACK (on_window_closed),
+												  NULL);
+
+	g_free (settle_name);
+	settle_name = g_strdup (name);
+	settle_start = ww_stats_now ();
+	settle_n_windows = settle_entries->len;
+	settle_given_up = 0;
+	settle_pass = 1;
+
+	for (i = 0; i < settle_entries->len; i++)
+	{
+		entry = &g_array_index (settle_entries, WwSettleEntry, i);
+		entry->handler = g_signal_connect (entry->window, "geometry-changed",
+										   G_CALLBACK (on_geometry_changed),
+										   NULL);
+	}
+
+	settle_timeout = g_timeout_add (WW_SETTLE_TIMEOUT, on_timeout, NULL);
+}
+
+/**
+ * ww_settle_wait
+ *
+ * Run the main loop until the settle phase is over. For one-shot
+ * invocations, which would otherwise exit before the window manager has
+ * answered.
+ */
+void
+ww_settle_wait (void)
+{
+	if (settle_pass == 0)
+		return;
+
+	settle_loop = g_main_loop_new (NULL, FALSE);
+	g_main_loop_run (settle_loop);
+	g_main_loop_unref (settle_loop);
+	settle_loop = NULL;
+}
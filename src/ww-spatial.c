@@ -0,0 +1,739 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A 2-d tree over window centres used for spatial window switching.
+ *
+ * Points are added in any order and the tree is built lazily on the first
+ * lookup after a change. The tree is stored implicitly in a flat array: the
+ * median of each range is the node and the halves on either side are its
+ * subtrees, alternating between splitting on x and y.
+ *
+ * The distance measure is the one spatial switching has always used: the
+ * axis perpendicular to the direction of movement counts double. Distances
+ * are compared squared, and ties go to the point that was added first.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ww-spatial.h"
+
+/* Neighbours further away than this are never picked */
+#define WW_SPATIAL_MAX_DIST 100000.0
+
+typedef struct
+{
+	int			x, y;
+	guint		order;		/* insertion order, used to break ties */
+	gpointer	data;
+} WwSpatialPoint;
+
+struct _WwSpatialIndex
+{
+	GArray		*points;
+	gboolean	built;
+};
+
+typedef struct
+{
+	int				qx, qy;			/* query point */
+	WwDirection		direction;
+	double			wx, wy;			/* weights for each axis */
+	WwSpatialPoint	*best;
+	double			best_dist;
+} WwSpatialQuery;
+
+/**
+ * ww_spatial_index_new
+ *
+ * Return value: A new empty index. Free with ww_spatial_index_free()
+ */
+WwSpatialIndex*
+ww_spatial_index_new (void)
+{
+	WwSpatialIndex	*index;
+
+	index = g_new0 (WwSpatialIndex, 1);
+	index->points = g_array_new (FALSE, FALSE, sizeof (WwSpatialPoint));
+	index->built = TRUE;
+
+	return index;
+}
+
+void
+ww_spatial_index_free (WwSpatialIndex *index)
+{
+	g_return_if_fail (index != NULL);
+
+	g_array_free (index->points, TRUE);
+	g_free (index);
+}
+
+/**
+ * ww_spatial_index_clear
+ * @index: The index to clear
+ *
+ * Remove all points from @index. The storage is kept for reuse.
+ */
+void
+ww_spatial_index_clear (WwSpatialIndex *index)
+{
+	g_return_if_fail (index != NULL);
+
+	g_array_set_size (index->points, 0);
+	index->built = TRUE;
+}
+
+/**
+ * ww_spatial_index_add
+ * @index: The index to add a point to
+ * @center_x: X coordinate of the centre of the window
+ * @center_y: Y coordinate of the centre of the window
+ * @data: User data returned from lookups
+ *
+ * Add a window centre to @index. The tree is rebuilt on the next lookup.
+ */
+void
+ww_spatial_index_add (WwSpatialIndex	*index,
+					  int				center_x,
+					  int				center_y,
+					  gpointer			data)
+{
+	WwSpatialPoint	point;
+
+	g_return_if_fail (index != NULL);
+
+	point.x = center_x;
+	point.y = center_y;
+	point.order = index->points->len;
+	point.data = data;
+	g_array_append_val (index->points, point);
+
+	index->built = FALSE;
+}
+
+guint
+ww_spatial_index_get_size (WwSpatialIndex *index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+
+	return index->points->len;
+}
+
+static inline int
+point_coord (const WwSpatialPoint *p, int axis)
+{
+	return axis == 0 ? p->x : p->y;
+}
+
+/* Quickselect: partition points[lo..hi] so that points[k] holds the
+ * element that would be there if the range was sorted on @axis */
+static void
+select_median (WwSpatialPoint *points, int lo, int hi, int k, int axis)
+{
+	WwSpatialPoint	tmp;
+	int				pivot, i, store;
+
+	while (lo < hi)
+	{
+		/* Middle element as pivot, moved out of the way */
+		i = lo + (hi - lo) / 2;
+		tmp = points[i]; points[i] = points[hi]; points[hi] = tmp;
+		pivot = point_coord (&points[hi], axis);
+
+		store = lo;
+		for (i = lo; i < hi; i++)
+		{
+			if (point_coord (&points[i], axis) < pivot)
+			{
+				tmp = points[i]; points[i] = points[store]; points[store] = tmp;
+				store++;
+			}
+		}
+		tmp = points[store]; points[store] = points[hi]; points[hi] = tmp;
+
+		if (store == k)
+			return;
+		else if (k < store)
+			hi = store - 1;
+		else
+			lo = store + 1;
+	}
+}
+
+static void
+build_tree (WwSpatialPoint *points, int lo, int hi, int axis)
+{
+	int	mid;
+
+	if (lo >= hi)
+		return;
+
+	mid = lo + (hi - lo) / 2;
+	select_median (points, lo, hi, mid, axis);
+
+	build_tree (points, lo, mid - 1, !axis);
+	build_tree (points, mid + 1, hi, !axis);
+}
+
+static void
+ensure_built (WwSpatialIndex *index)
+{
+	if (index->built)
+		return;
+
+	build_tree ((WwSpatialPoint*) index->points->data,
+				0, (int) index->points->len - 1, 0);
+	index->built = TRUE;
+}
+
+/* Whether @p lies strictly in the queried direction */
+static inline gboolean
+in_direction (const WwSpatialQuery *q, const WwSpatialPoint *p)
+{
+	switch (q->direction)
+	{
+		case LEFT:  return p->x < q->qx;
+		case RIGHT: return p->x > q->qx;
+		case UP:    return p->y < q->qy;
+		case DOWN:  return p->y > q->qy;
+	}
+	return FALSE;
+}
+
+static void
+search_tree (WwSpatialQuery *q, WwSpatialPoint *points, int lo, int hi,
+			 int axis)
+{
+	WwSpatialPoint	*node;
+	double			dx, dy, dist, plane;
+	int				mid, split, qc;
+	gboolean		near_is_low;
+
+	if (lo > hi)
+		return;
+
+	mid = lo + (hi - lo) / 2;
+	node = &points[mid];
+
+	if (in_direction (q, node))
+	{
+		dx = node->x - q->qx;
+		dy = node->y - q->qy;
+		dist = q->wx * dx * dx + q->wy * dy * dy;
+
+		if (dist < q->best_dist ||
+			(dist == q->best_dist && q->best && node->order < q->best->order))
+		{
+			q->best = node;
+			q->best_dist = dist;
+		}
+	}
+
+	split = point_coord (node, axis);
+	qc = axis == 0 ? q->qx : q->qy;
+	near_is_low = qc < split;
+
+	/* The low half holds coordinates <= split and the high half >= split.
+	 * A half lying entirely on the wrong side of the query point can not
+	 * contain any candidates. */
+	if (axis == 0 && q->direction == LEFT && split >= q->qx)
+	{
+		search_tree (q, points, lo, mid - 1, !axis);
+		return;
+	}
+	if (axis == 0 && q->direction == RIGHT && split <= q->qx)
+	{
+		search_tree (q, points, mid + 1, hi, !axis);
+		return;
+	}
+	if (axis == 1 && q->direction == UP && split >= q->qy)
+	{
+		search_tree (q, points, lo, mid - 1, !axis);
+		return;
+	}
+	if (axis == 1 && q->direction == DOWN && split <= q->qy)
+	{
+		search_tree (q, points, mid + 1, hi, !axis);
+		return;
+	}
+
+	if (near_is_low)
+		search_tree (q, points, lo, mid - 1, !axis);
+	else
+		search_tree (q, points, mid + 1, hi, !axis);
+
+	/* Only visit the far half if the splitting plane is close enough */
+	plane = (double) (qc - split) * (qc - split) * (axis == 0 ? q->wx : q->wy);
+	if (plane <= q->best_dist)
+	{
+		if (near_is_low)
+			search_tree (q, points, mid + 1, hi, !axis);
+		else
+			search_tree (q, points, lo, mid - 1, !axis);
+	}
+}
+
+/**
+ * ww_spatial_index_find_neighbour
+ * @index: The index to search
+ * @center_x: X coordinate of the centre of the active window
+ * @center_y: Y coordinate of the centre of the active window
+ * @direction: The direction to look in
+ *
+ * Find the nearest point lying in @direction from (@center_x, @center_y).
+ * When moving left or right differences in the y-dimension count double,
+ * and when moving up or down differences in the x-dimension do.
+ *
+ * Return value: The data of the neighbouring point or %NULL if there is none
+ */
+gpointer
+ww_spatial_index_find_neighbour (WwSpatialIndex	*index,
+								 int			center_x,
+								 int			center_y,
+								 WwDirection	direction)
+{
+	WwSpatialQuery	q;
+
+	g_return_val_if_fail (index != NULL, NULL);
+
+	if (index->points->len == 0)
+		return NULL;
+
+	ensure_built (index);
+
+	q.qx = center_x;
+	q.qy = center_y;
+	q.direction = direction;
+	q.wx = (direction == UP || direction == DOWN) ? 2.0 : 1.0;
+	q.wy = (direction == LEFT || direction == RIGHT) ? 2.0 : 1.0;
+	q.best = NULL;
+	q.best_dist = WW_SPATIAL_MAX_DIST * WW_SPATIAL_MAX_DIST;
+
+	search_tree (&q, (WwSpatialPoint*) index->points->data,
+				 0, (int) index->points->len - 1, 0);
+
+	return q.best ? q.best->data : NULL;
+}
+
+/*
+ * The neighbour graph holds the result of ww_spatial_index_find_neighbour()
+ * for every point in all four directions, so a lookup is a hash table
+ * lookup. When a point is added, moved or removed only the entries it can
+ * affect are recomputed: its own, the ones pointing at it, and the ones it
+ * beats. Ties go to the point that was added to the graph first.
+ */
+
+typedef struct
+{
+	gpointer	data;
+	int			x, y;
+	guint		order;			/* insertion order, used to break ties */
+	guint		generation;		/* last ww_neighbour_graph_begin_sync() seen */
+	gpointer	neighbours[4];	/* indexed by WwDirection */
+	guint		neighbour_order[4];
+	double		neighbour_dist[4];
+} WwGraphNode;
+
+struct _WwNeighbourGraph
+{
+	GArray		*nodes;
+	GHashTable	*index;			/* data to position in nodes + 1 */
+	guint		next_order;
+	guint		generation;
+};
+
+/* The weighted squared distance from @from to @to in @direction, or -1 if
+ * @to isn't a candidate */
+static inline double
+node_dist (const WwGraphNode *from, const WwGraphNode *to,
+		   WwDirection direction)
+{
+	double	dx, dy, dist;
+
+	switch (direction)
+	{
+		case LEFT:  if (to->x >= from->x) return -1; break;
+		case RIGHT: if (to->x <= from->x) return -1; break;
+		case UP:    if (to->y >= from->y) return -1; break;
+		case DOWN:  if (to->y <= from->y) return -1; break;
+	}
+
+	dx = to->x - from->x;
+	dy = to->y - from->y;
+	if (direction == LEFT || direction == RIGHT)
+		dist = dx * dx + 2.0 * dy * dy;
+	else
+		dist = 2.0 * dx * dx + dy * dy;
+
+	if (dist >= WW_SPATIAL_MAX_DIST * WW_SPATIAL_MAX_DIST)
+		return -1;
+
+	return dist;
+}
+
+/* Make @to the neighbour of @from in @direction if it beats the current
+ * one. Returns TRUE if it did */
+static inline gboolean
+offer_neighbour (WwGraphNode *from, const WwGraphNode *to,
+				 WwDirection direction)
+{
+	double	dist;
+
+	dist = node_dist (from, to, direction);
+	if (dist < 0)
+		return FALSE;
+
+	if (from->neighbours[direction] == NULL ||
+		dist < from->neighbour_dist[direction] ||
+		(dist == from->neighbour_dist[direction] &&
+		 to->order < from->neighbour_order[direction]))
+	{
+		from->neighbours[direction] = to->data;
+		from->neighbour_order[direction] = to->order;
+		from->neighbour_dist[direction] = dist;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+compute_neighbours (WwNeighbourGraph *graph, WwGraphNode *node)
+{
+	WwGraphNode	*nodes;
+	guint		i;
+	int			d;
+
+	nodes = (WwGraphNode*) graph->nodes->data;
+
+	for (d = 0; d < 4; d++)
+		node->neighbours[d] = NULL;
+
+	for (i = 0; i < graph->nodes->len; i++)
+	{
+		if (&nodes[i] == node)
+			continue;
+		for (d = 0; d < 4; d++)
+			offer_neighbour (node, &nodes[i], d);
+	}
+}
+
+/* Update every other node after @data moved to @changed, or was removed if
+ * @changed is %NULL */
+static void
+update_others (WwNeighbourGraph *graph, gpointer data, WwGraphNode *changed)
+{
+	WwGraphNode	*nodes, *node;
+	guint		i;
+	int			d;
+	gboolean	stale;
+
+	nodes = (WwGraphNode*) graph->nodes->data;
+
+	for (i = 0; i < graph->nodes->len; i++)
+	{
+		node = &nodes[i];
+		if (node == changed)
+			continue;
+
+		stale = FALSE;
+		for (d = 0; d < 4; d++)
+		{
+			/* It may have moved away, so look again */
+			if (node->neighbours[d] == data)
+				stale = TRUE;
+			else if (changed)
+				offer_neighbour (node, changed, d);
+		}
+
+		if (stale)
+			compute_neighbours (graph, node);
+	}
+}
+
+/**
+ * ww_neighbour_graph_new
+ *
+ * Return value: A new empty graph. Free with ww_neighbour_graph_free()
+ */
+WwNeighbourGraph*
+ww_neighbour_graph_new (void)
+{
+	WwNeighbourGraph	*graph;
+
+	graph = g_new0 (WwNeighbourGraph, 1);
+	graph->nodes = g_array_new (FALSE, FALSE, sizeof (WwGraphNode));
+	graph->index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	return graph;
+}
+
+void
+ww_neighbour_graph_free (WwNeighbourGraph *graph)
+{
+	g_return_if_fail (graph != NULL);
+
+	g_array_free (graph->nodes, TRUE);
+	g_hash_table_destroy (graph->index);
+	g_free (graph);
+}
+
+/**
+ * ww_neighbour_graph_clear
+ * @graph: The graph to clear
+ *
+ * Remove all points from @graph
+ */
+void
+ww_neighbour_graph_clear (WwNeighbourGraph *graph)
+{
+	g_return_if_fail (graph != NULL);
+
+	g_array_set_size (graph->nodes, 0);
+	g_hash_table_remove_all (graph->index);
+	graph->next_order = 0;
+}
+
+/**
+ * ww_neighbour_graph_set
+ * @graph: The graph to update
+ * @data: The window, as returned from lookups
+ * @center_x: X coordinate of the centre of the window
+ * @center_y: Y coordinate of the centre of the window
+ *
+ * Add a window to @graph, or move it if it is already in it. The
+ * neighbours of the other windows are updated right away.
+ *
+ * Return value: %TRUE if the graph changed
+ */
+gboolean
+ww_neighbour_graph_set (WwNeighbourGraph	*graph,
+						gpointer			data,
+						int					center_x,
+						int					center_y)
+{
+	WwGraphNode	node, *existing;
+	guint		pos;
+
+	g_return_val_if_fail (graph != NULL, FALSE);
+
+	pos = GPOINTER_TO_UINT (g_hash_table_lookup (graph->index, data));
+	if (pos > 0)
+	{
+		existing = &g_array_index (graph->nodes, WwGraphNode, pos - 1);
+		existing->generation = graph->generation;
+		if (existing->x == center_x && existing->y == center_y)
+			return FALSE;
+
+		existing->x = center_x;
+		existing->y = center_y;
+	}
+	else
+	{
+		memset (&node, 0, sizeof (node));
+		node.data = data;
+		node.x = center_x;
+		node.y = center_y;
+		node.order = graph->next_order++;
+		node.generation = graph->generation;
+		g_array_append_val (graph->nodes, node);
+
+		pos = graph->nodes->len;
+		g_hash_table_insert (graph->index, data, GUINT_TO_POINTER (pos));
+		existing = &g_array_index (graph->nodes, WwGraphNode, pos - 1);
+	}
+
+	compute_neighbours (graph, existing);
+	update_others (graph, data, existing);
+
+	return TRUE;
+}
+
+/**
+ * ww_neighbour_graph_remove
+ * @graph: The graph to update
+ * @data: The window to remove
+ *
+ * Remove a window from @graph and find new neighbours for the windows that
+ * had it as their neighbour.
+ *
+ * Return value: %FALSE if @data wasn't in the graph
+ */
+gboolean
+ww_neighbour_graph_remove (WwNeighbourGraph *graph, gpointer data)
+{
+	WwGraphNode	*last;
+	guint		pos;
+
+	g_return_val_if_fail (graph != NULL, FALSE);
+
+	pos = GPOINTER_TO_UINT (g_hash_table_lookup (graph->index, data));
+	if (pos == 0)
+		return FALSE;
+
+	g_hash_table_remove (graph->index, data);
+
+	/* Move the last node into the hole */
+	if (pos < graph->nodes->len)
+	{
+		last = &g_array_index (graph->nodes, WwGraphNode,
+							   graph->nodes->len - 1);
+		g_hash_table_insert (graph->index, last->data, GUINT_TO_POINTER (pos));
+	}
+	g_array_remove_index_fast (graph->nodes, pos - 1);
+
+	update_others (graph, data, NULL);
+
+	return TRUE;
+}
+
+/**
+ * ww_neighbour_graph_begin_sync
+ * @graph: The graph to synchronise
+ *
+ * Start bringing @graph in line with a new set of windows. Call
+ * ww_neighbour_graph_set() for each of them and then
+ * ww_neighbour_graph_end_sync() to remove the windows that weren't set.
+ * Windows that haven't moved cost a hash table lookup.
+ */
+void
+ww_neighbour_graph_begin_sync (WwNeighbourGraph *graph)
+{
+	g_return_if_fail (graph != NULL);
+
+	graph->generation++;
+}
+
+/**
+ * ww_neighbour_graph_end_sync
+ * @graph: The graph to synchronise
+ *
+ * Remove the windows that weren't set since ww_neighbour_graph_begin_sync()
+ *
+ * Return value: The number of windows removed
+ */
+guint
+ww_neighbour_graph_end_sync (WwNeighbourGraph *graph)
+{
+	WwGraphNode	*node;
+	guint		i, removed;
+
+	g_return_val_if_fail (graph != NULL, 0);
+
+	removed = 0;
+	i = 0;
+	while (i < graph->nodes->len)
+	{
+		node = &g_array_index (graph->nodes, WwGraphNode, i);
+		if (node->generation != graph->generation)
+		{
+			/* The last node takes its place, so look at i again */
+			ww_neighbour_graph_remove (graph, node->data);
+			removed++;
+		}
+		else
+			i++;
+	}
+
+	return removed;
+}
+
+guint
+ww_neighbour_graph_get_size (WwNeighbourGraph *graph)
+{
+	g_return_val_if_fail (graph != NULL, 0);
+
+	return graph->nodes->len;
+}
+
+/**
+ * ww_neighbour_graph_lookup
+ * @graph: The graph to look in
+ * @data: The window to start from
+ * @direction: The direction to look in
+ * @neighbour: Return location for the neighbour of @data, %NULL if it has
+ *             none
+ *
+ * Look up the nearest window in @direction of @data, as
+ * ww_spatial_index_find_neighbour() would find it.
+ *
+ * Return value: %FALSE if @data isn't in @graph
+ */
+gboolean
+ww_neighbour_graph_lookup (WwNeighbourGraph	*graph,
+						   gpointer			data,
+						   WwDirection		direction,
+						   gpointer			*neighbour)
+{
+	guint	pos;
+
+	g_return_val_if_fail (graph != NULL, FALSE);
+
+	pos = GPOINTER_TO_UINT (g_hash_table_lookup (graph->index, data));
+	if (pos == 0)
+		return FALSE;
+
+	*neighbour = g_array_index (graph->nodes, WwGraphNode,
+								pos - 1).neighbours[direction];
+	return TRUE;
+}
+
+static int
+compare_node_order (const void *a, const void *b)
+{
+	const WwGraphNode	*na = *(const WwGraphNode **) a;
+	const WwGraphNode	*nb = *(const WwGraphNode **) b;
+
+	return na->order < nb->order ? -1 : na->order > nb->order;
+}
+
+/**
+ * ww_neighbour_graph_foreach
+ * @graph: The graph to walk
+ * @func: Called with each window, its centre and its neighbours, indexed
+ *        by #WwDirection
+ * @user_data: Passed to @func
+ *
+ * Call @func for every window in @graph, in the order they were added
+ */
+void
+ww_neighbour_graph_foreach (WwNeighbourGraph	*graph,
+							WwNeighbourFunc		func,
+							gpointer			user_data)
+{
+	WwGraphNode	**sorted;
+	guint		i, n;
+
+	g_return_if_fail (graph != NULL);
+	g_return_if_fail (func != NULL);
+
+	n = graph->nodes->len;
+	sorted = g_new (WwGraphNode*, MAX (n, 1));
+	for (i = 0; i < n; i++)
+		sorted[i] = &g_array_index (graph->nodes, WwGraphNode, i);
+	qsort (sorted, n, sizeof (WwGraphNode*), compare_node_order);
+
+	for (i = 0; i < n; i++)
+		func (sorted[i]->data, sorted[i]->x, sorted[i]->y,
+			  (gpointer const *) sorted[i]->neighbours, user_data);
+
+	g_free (sorted);
+}
@@ -0,0 +1,94 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WW_SPATIAL_H_
+#define _WW_SPATIAL_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	LEFT,
+	RIGHT,
+	UP,
+	DOWN
+} WwDirection;
+
+typedef struct _WwSpatialIndex WwSpatialIndex;
+
+WwSpatialIndex*		ww_spatial_index_new		(void);
+
+void				ww_spatial_index_free		(WwSpatialIndex *index);
+
+void				ww_spatial_index_clear		(WwSpatialIndex *index);
+
+void				ww_spatial_index_add		(WwSpatialIndex *index,
+												 int center_x,
+												 int center_y,
+												 gpointer data);
+
+guint				ww_spatial_index_get_size	(WwSpatialIndex *index);
+
+gpointer			ww_spatial_index_find_neighbour	(WwSpatialIndex *index,
+													 int center_x,
+													 int center_y,
+													 WwDirection direction);
+
+typedef struct _WwNeighbourGraph WwNeighbourGraph;
+
+typedef void (*WwNeighbourFunc) (gpointer data,
+								 int center_x,
+								 int center_y,
+								 gpointer const *neighbours,
+								 gpointer user_data);
+
+WwNeighbourGraph*	ww_neighbour_graph_new		(void);
+
+void				ww_neighbour_graph_free		(WwNeighbourGraph *graph);
+
+void				ww_neighbour_graph_clear	(WwNeighbourGraph *graph);
+
+gboolean			ww_neighbour_graph_set		(WwNeighbourGraph *graph,
+												 gpointer data,
+												 int center_x,
+												 int center_y);
+
+gboolean			ww_neighbour_graph_remove	(WwNeighbourGraph *graph,
+												 gpointer data);
+
+void				ww_neighbour_graph_begin_sync	(WwNeighbourGraph *graph);
+
+guint				ww_neighbour_graph_end_sync	(WwNeighbourGraph *graph);
+
+guint				ww_neighbour_graph_get_size	(WwNeighbourGraph *graph);
+
+gboolean			ww_neighbour_graph_lookup	(WwNeighbourGraph *graph,
+												 gpointer data,
+												 WwDirection direction,
+												 gpointer *neighbour);
+
+void				ww_neighbour_graph_foreach	(WwNeighbourGraph *graph,
+												 WwNeighbourFunc func,
+												 gpointer user_data);
+
+G_END_DECLS
+
+#endif /* _WW_SPATIAL_H_ */
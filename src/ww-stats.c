@@ -0,0 +1,342 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Latency statistics for applying layouts. Every phase of every layout gets
+ * a fixed size histogram of microseconds, so recording a sample is a
+ * couple of integer operations and never allocates once the layout has
+ * been seen. Buckets are a quarter power of two wide and percentiles are
+ * reported as the middle of their bucket, which is within 12% of the true
+ * value.
+ */
+
+#include "winwrangler.h"
+
+#define WW_STATS_SUB_BUCKETS 4
+#define WW_STATS_BUCKETS 128
+
+typedef struct
+{
+	guint32		buckets[WW_STATS_BUCKETS];
+	guint32		count;
+	gint64		max;
+	gint64		sum;
+} WwHistogram;
+
+typedef struct
+{
+	WwHistogram	phases[WW_N_PHASES];
+} WwLayoutStats;
+
+static const gchar *phase_names[WW_N_PHASES] = {
+	"hotkey",
+	"refresh",
+	"compute",
+	"commit",
+	"total",
+	"startup",
+	"settle"
+};
+
+static const gchar *counter_names[WW_N_COUNTERS] = {
+	"requests",
+	"coalesced",
+	"activations",
+	"focus_coalesced",
+	"settle_passes",
+	"corrections",
+	"unsettled"
+};
+
+static GHashTable *layout_stats = NULL;
+static guint64 counters[WW_N_COUNTERS] = { 0 };
+static gint64 startup_start = 0;
+
+/* Map a duration in microseconds to a histogram bucket */
+static guint
+bucket_for_value (gint64 usec)
+{
+	guint	msb;
+
+	if (usec < WW_STATS_SUB_BUCKETS)
+		return MAX (usec, 0);
+
+	msb = g_bit_storage (usec) - 1;
+	return MIN (WW_STATS_SUB_BUCKETS +
+				(msb - 2) * WW_STATS_SUB_BUCKETS +
+				((usec >> (msb - 2)) & (WW_STATS_SUB_BUCKETS - 1)),
+				WW_STATS_BUCKETS - 1);
+}
+
+/* The smallest value that falls in @bucket */
+static gint64
+value_for_bucket (guint bucket)
+{
+	guint	msb, sub;
+
+	if (bucket < WW_STATS_SUB_BUCKETS)
+		return bucket;
+
+	msb = (bucket - WW_STATS_SUB_BUCKETS) / WW_STATS_SUB_BUCKETS + 2;
+	sub = (bucket - WW_STATS_SUB_BUCKETS) % WW_STATS_SUB_BUCKETS;
+	return ((gint64) (WW_STATS_SUB_BUCKETS + sub)) << (msb - 2);
+}
+
+static gint64
+histogram_percentile (WwHistogram *hist, double percentile)
+{
+	guint32	rank, seen;
+	guint	i;
+
+	if (hist->count == 0)
+		return 0;
+
+	rank = (guint32) (hist->count * percentile / 100.0 + 0.5);
+	rank = CLAMP (rank, 1, hist->count);
+
+	seen = 0;
+	for (i = 0; i < WW_STATS_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			return MIN ((value_for_bucket (i) + value_for_bucket (i + 1)) / 2,
+						hist->max);
+	}
+
+	return hist->max;
+}
+
+/**
+ * ww_stats_now
+ *
+ * Return value: The current monotonic time in microseconds, for use with
+ *               ww_stats_record()
+ */
+gint64
+ww_stats_now (void)
+{
+	return g_get_monotonic_time ();
+}
+
+/**
+ * ww_stats_record
+ * @layout_name: The name of the layout the sample belongs to
+ * @phase: The phase that was timed
+ * @start: The value of ww_stats_now() when the phase started
+ *
+ * Record the time spent in a phase of applying a layout, ending now.
+ */
+void
+ww_stats_record (const gchar *layout_name, WwPhase phase, gint64 start)
+{
+	WwLayoutStats	*stats;
+	WwHistogram		*hist;
+	gint64			usec;
+
+	g_return_if_fail (layout_name != NULL);
+	g_return_if_fail (phase < WW_N_PHASES);
+
+	usec = ww_stats_now () - start;
+
+	if (layout_stats == NULL)
+		layout_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+											  g_free, g_free);
+
+	stats = g_hash_table_lookup (layout_stats, layout_name);
+	if (stats == NULL)
+	{
+		stats = g_new0 (WwLayoutStats, 1);
+		g_hash_table_insert (layout_stats, g_strdup (layout_name), stats);
+	}
+
+	hist = &stats->phases[phase];
+	hist->buckets[bucket_for_value (usec)]++;
+	hist->count++;
+	hist->sum += usec;
+	hist->max = MAX (hist->max, usec);
+}
+
+/**
+ * ww_stats_count
+ * @counter: The counter to increase
+ * @n: The amount to add
+ *
+ * Count an event of the hotkey dispatcher
+ */
+void
+ww_stats_count (WwCounter counter, guint n)
+{
+	g_return_if_fail (counter < WW_N_COUNTERS);
+
+	counters[counter] += n;
+}
+
+/**
+ * ww_stats_startup_begin
+ *
+ * Start timing the startup of the process. Call first thing in main()
+ */
+void
+ww_stats_startup_begin (void)
+{
+	startup_start = ww_stats_now ();
+}
+
+/**
+ * ww_stats_startup_done
+ * @name: The layout or mode the process was started for
+ *
+ * Record the time since ww_stats_startup_begin() as the startup phase of
+ * @name. Call once the first geometry change has been sent to the X
+ * server, or when the mode has nothing to send, once its work is done.
+ * Only the first call after ww_stats_startup_begin() is recorded.
+ */
+void
+ww_stats_startup_done (const gchar *name)
+{
+	if (startup_start == 0)
+		return;
+
+	ww_stats_record (name, WW_PHASE_STARTUP, startup_start);
+	startup_start = 0;
+}
+
+static void
+append_counters (GString *out)
+{
+	guint	i;
+
+	for (i = 0; i < WW_N_COUNTERS; i++)
+		g_string_append_printf (out, "%s%s=%" G_GUINT64_FORMAT,
+								i > 0 ? " " : "", counter_names[i],
+								counters[i]);
+}
+
+static void
+append_layout_stats (GString		*out,
+					 const gchar	*name,
+					 WwLayoutStats	*stats,
+					 gboolean		one_line)
+{
+	WwHistogram	*hist;
+	guint		phase;
+
+	if (one_line)
+		g_string_append_printf (out, "%s:", name);
+
+	for (phase = 0; phase < WW_N_PHASES; phase++)
+	{
+		hist = &stats->phases[phase];
+		if (hist->count == 0)
+			continue;
+
+		if (one_line)
+			g_string_append_printf (out, " %s=%" G_GINT64_FORMAT "/%"
+									G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
+									phase_names[phase],
+									histogram_percentile (hist, 50),
+									histogram_percentile (hist, 99),
+									hist->max);
+		else
+			g_string_append_printf (out, "%-15s %-8s %8u %10" G_GINT64_FORMAT
+									" %10" G_GINT64_FORMAT
+									" %10" G_GINT64_FORMAT
+									" %10" G_GINT64_FORMAT "\n",
+									name, phase_names[phase], hist->count,
+									hist->sum / hist->count,
+									histogram_percentile (hist, 50),
+									histogram_percentile (hist, 99),
+									hist->max);
+	}
+}
+
+static gchar*
+format_stats (gboolean one_line)
+{
+	GHashTableIter	iter;
+	GString			*out;
+	gpointer		name, stats;
+
+	out = g_string_new (NULL);
+
+	if (!one_line)
+		g_string_append_printf (out, "%-15s %-8s %8s %10s %10s %10s %10s\n",
+								"layout", "phase", "count", "mean_us",
+								"p50_us", "p99_us", "max_us");
+
+	if (layout_stats)
+	{
+		g_hash_table_iter_init (&iter, layout_stats);
+		while (g_hash_table_iter_next (&iter, &name, &stats))
+		{
+			if (one_line && out->len > 0)
+				g_string_append (out, "; ");
+			append_layout_stats (out, name, stats, one_line);
+		}
+	}
+
+	return g_string_free (out, FALSE);
+}
+
+/**
+ * ww_stats_print
+ *
+ * Print a table with the number of samples, mean, p50, p99 and maximum
+ * latency of every phase of every layout applied so far, followed by the
+ * counters of the hotkey dispatcher
+ */
+void
+ww_stats_print (void)
+{
+	gchar	*table;
+	GString	*line;
+
+	table = format_stats (FALSE);
+	g_print ("%s", table);
+	g_free (table);
+	
+	line = g_string_new (NULL);
+	append_counters (line);
+	g_print ("%s\n", line->str);
+	g_string_free (line, TRUE);
+}
+
+/**
+ * ww_stats_log
+ *
+ * Log p50/p99/max in microseconds for every phase of every layout applied
+ * so far on a single line, and the counters of the hotkey dispatcher on
+ * another
+ */
+void
+ww_stats_log (void)
+{
+	gchar	*line;
+	GString	*count_line;
+
+	line = format_stats (TRUE);
+	g_message ("Layout latency p50/p99/max us: %s",
+			   *line ? line : "no layouts applied");
+	g_free (line);
+	
+	count_line = g_string_new (NULL);
+	append_counters (count_line);
+	g_message ("Hotkey requests: %s", count_line->str);
+	g_string_free (count_line, TRUE);
+}
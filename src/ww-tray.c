@@ -27,66 +27,42 @@ static void
 dispatch_layout_handler (GtkAction *action, gpointer data)
 {
 	const gchar	*name;
-	const WwLayout	*layout;
+	GError		*error;
 	
 	g_return_if_fail (GTK_IS_ACTION(action));
 	
 	name = gtk_action_get_name (action);
-	layout = ww_get_layout (name);
-	
-	if (!layout) {
-		g_critical ("Requested unknown layout '%s'", name);
-		return;
-	}
-	
-	WnckScreen		*screen;
-	WnckWorkspace   *ws;
-	GList			*windows, *struts;
-	WnckWindow		*active;
-	GError			*error;
-	
-	screen = wnck_screen_get_default ();
-	wnck_screen_force_update (screen);
-	
-	windows = wnck_screen_get_windows (screen);
-	ws = wnck_screen_get_active_workspace (screen);
-	struts = ww_filter_strut_windows (windows, ws);
-	windows = ww_filter_user_windows (windows, ws);
-	active = wnck_screen_get_active_window (screen);
 	
 	error = NULL;
-	layout->handler (screen, windows, struts, active, &error);
-	g_list_free (windows);
-	g_list_free (struts);
-	
-	if (error) {
-		g_critical ("Error applying layout '%s': %s", name, error->message);
+	if (!ww_apply_layout_by_name (name, &error))
+	{
+		g_warning ("Failed to apply layout '%s': %s", name, error->message);
 		g_error_free (error);
-		return;
 	}
-	
-	
 }
 
 static GtkActionGroup*
-create_action_group (const WwLayout *layouts)
+create_action_group (GList *layouts)
 {
 	GtkActionGroup  *actions;
 	GtkActionEntry	*entries;
+	const WwLayout	*layout;
 	guint			num_layouts;
+	GList			*iter;
 	
 	num_layouts = ww_get_num_layouts ();
 	actions = gtk_action_group_new ("winwrangler-tray");
 	entries = g_new0 (GtkActionEntry, num_layouts);
 	
 	gint i;
-	for (i = 0; i < num_layouts; i++)
+	for (i = 0, iter = layouts; iter; i++, iter = iter->next)
 	{
-		g_debug ("Adding GtkActionEntry '%s'", layouts[i].name);
-		entries[i].name = layouts[i].name;
-		entries[i].label = layouts[i].label;
-		entries[i].tooltip = layouts[i].desc;
-		entries[i].accelerator = layouts[i].default_hotkey; // FIXME: Hardcoded hotkey
+		layout = iter->data;
+		g_debug ("Adding GtkActionEntry '%s'", layout->name);
+		entries[i].name = layout->name;
+		entries[i].label = layout->label;
+		entries[i].tooltip = layout->desc;
+		entries[i].accelerator = layout->default_hotkey; // FIXME: Hardcoded hotkey
 		entries[i].callback = G_CALLBACK (dispatch_layout_handler);
 	}
 	
@@ -98,20 +74,24 @@ create_action_group (const WwLayout *layouts)
 }
 
 static gchar*
-create_ui_def (const WwLayout *layouts)
+create_ui_def (GList *layouts)
 {
-	/* FIXME: This should be autogenerated */
-	return g_strdup ("<ui>"
-                     "  <popup>"
-					 "      <menuitem action=\"expand\"/>"
-					 "      <menuitem action=\"tile\"/>"
-					 "      <menuitem action=\"twothirds\"/>"
-					 "      <menuitem action=\"activate_left\"/>"
-					 "      <menuitem action=\"activate_right\"/>"
-					 "      <menuitem action=\"activate_up\"/>"
-					 "      <menuitem action=\"activate_down\"/>"
-					 "  </popup>"
-					 "</ui>");
+	const WwLayout	*layout;
+	GString			*ui_def;
+	GList			*iter;
+	
+	/* One menu item per registered layout, so layouts from modules show
+	 * up too */
+	ui_def = g_string_new ("<ui>  <popup>");
+	for (iter = layouts; iter; iter = iter->next)
+	{
+		layout = iter->data;
+		g_string_append_printf (ui_def, "    <menuitem action=\"%s\"/>",
+								layout->name);
+	}
+	g_string_append (ui_def, "  </popup></ui>");
+	
+	return g_string_free (ui_def, FALSE);
 }
 
 /* Callback for clicking tray icon */
@@ -157,7 +137,7 @@ override_dispose (GObject *obj)
 GtkStatusIcon*
 ww_tray_icon_new ()
 {	
-	const WwLayout	*layouts;
+	GList			*layouts;
 	GtkStatusIcon   *tray_icon;
 	GtkUIManager	*ui;
 	gchar		*ui_def;
@@ -0,0 +1,147 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The undo ring holds the window geometries from before the last
+ * WW_UNDO_DEPTH layouts. It is a static array, so recording a state never
+ * allocates, and the geometries are copied from the snapshot the layout
+ * works on, so it never talks to the X server either.
+ *
+ * A state is recorded into a separate static slot before every layout, and
+ * is only copied into the ring with ww_undo_push() once the layout has
+ * actually moved a window. Layouts that move nothing and dry runs never
+ * touch the ring, which matters once it is full and the slot after the
+ * newest state holds the oldest one.
+ */
+
+#include <string.h>
+
+#include "winwrangler.h"
+
+/* The number of layouts that can be undone */
+#define WW_UNDO_DEPTH 16
+
+/* Windows beyond this many on a workspace are not restored */
+#define WW_UNDO_MAX_WINDOWS 128
+
+typedef struct
+{
+	gulong		xid;		/* the window may be gone by the time of undo */
+	WwRect		geometry;
+} WwUndoEntry;
+
+typedef struct
+{
+	guint		n_entries;
+	WwUndoEntry	entries[WW_UNDO_MAX_WINDOWS];
+} WwUndoState;
+
+static WwUndoState	undo_recorded;		/* filled by ww_undo_record() */
+static WwUndoState	undo_ring[WW_UNDO_DEPTH];
+static guint		undo_head = 0;		/* the slot ww_undo_push() fills */
+static guint		undo_count = 0;
+
+/**
+ * ww_undo_record
+ * @snapshot: The windows a layout is about to be applied to
+ *
+ * Remember the geometry of the windows in @snapshot, to be added to the
+ * undo ring with ww_undo_push(). Recording again before pushing replaces
+ * the recorded state.
+ */
+void
+ww_undo_record (WwSnapshot *snapshot)
+{
+	WwUndoState		*state;
+	WwWindowDesc	*desc;
+	guint			i;
+
+	g_return_if_fail (snapshot != NULL);
+
+	state = &undo_recorded;
+	state->n_entries = MIN (snapshot->windows->len, WW_UNDO_MAX_WINDOWS);
+
+	for (i = 0; i < state->n_entries; i++)
+	{
+		desc = &g_array_index (snapshot->windows, WwWindowDesc, i);
+		state->entries[i].xid = wnck_window_get_xid (desc->data);
+		state->entries[i].geometry = desc->geometry;
+	}
+}
+
+/**
+ * ww_undo_push
+ *
+ * Add the state recorded by ww_undo_record() to the undo ring. If the ring
+ * is full the oldest state is dropped.
+ */
+void
+ww_undo_push (void)
+{
+	WwUndoState	*state;
+
+	state = &undo_ring[undo_head];
+	state->n_entries = undo_recorded.n_entries;
+	memcpy (state->entries, undo_recorded.entries,
+			undo_recorded.n_entries * sizeof (WwUndoEntry));
+
+	undo_head = (undo_head + 1) % WW_UNDO_DEPTH;
+	undo_count = MIN (undo_count + 1, WW_UNDO_DEPTH);
+}
+
+/**
+ * ww_undo_pop
+ * @plan: The plan to write the restored geometries to
+ *
+ * Take the newest state off the undo ring and plan to move its windows back.
+ * Windows that have been closed since are skipped.
+ *
+ * Return value: %FALSE if there is nothing to undo
+ */
+gboolean
+ww_undo_pop (WwPlan *plan)
+{
+	WwUndoState	*state;
+	WwUndoEntry	*entry;
+	WnckWindow	*win;
+	guint		i;
+
+	g_return_val_if_fail (plan != NULL, FALSE);
+
+	if (undo_count == 0)
+		return FALSE;
+
+	undo_head = (undo_head + WW_UNDO_DEPTH - 1) % WW_UNDO_DEPTH;
+	undo_count--;
+
+	state = &undo_ring[undo_head];
+	for (i = 0; i < state->n_entries; i++)
+	{
+		entry = &state->entries[i];
+		win = wnck_window_get (entry->xid);
+		if (win == NULL)
+			continue;
+
+		ww_plan_set_geometry (plan, win,
+							  entry->geometry.x, entry->geometry.y,
+							  entry->geometry.width, entry->geometry.height);
+	}
+
+	return TRUE;
+}
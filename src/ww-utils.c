@@ -17,327 +17,664 @@
  *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <math.h>
+#include <string.h>
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
 
 #include "winwrangler.h"
 
+/* Key for the WM_NORMAL_HINTS sizes of a window, cached on the WnckWindow */
+#define WW_SIZE_HINTS_KEY "ww-size-hints"
+
+/* Key for the _NET_FRAME_EXTENTS of a window, cached on the WnckWindow */
+#define WW_FRAME_EXTENTS_KEY "ww-frame-extents"
+
 static guint32 _event_time = 0;
+static gboolean _dry_run = FALSE;
+
+GQuark
+ww_error_quark (void)
+{
+	return g_quark_from_static_string ("ww-error-quark");
+}
+
+/* Read the minimum size, base size and size increments from
+ * WM_NORMAL_HINTS, as width and height each. Like the window manager, a
+ * missing minimum size defaults to the base size and the other way round.
+ * This is a round trip, so the result is kept until ww_forget_size_hints()
+ * is called */
+static const int*
+get_size_hints (WnckWindow *win)
+{
+	XSizeHints	hints;
+	long		supplied;
+	int			*size;
+	Status		status;
+	
+	size = g_object_get_data (G_OBJECT (win), WW_SIZE_HINTS_KEY);
+	if (size)
+		return size;
+	
+	size = g_new0 (int, 6);
+	
+	gdk_error_trap_push ();
+	status = XGetWMNormalHints (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+								wnck_window_get_xid (win),
+								&hints, &supplied);
+	if (gdk_error_trap_pop () == 0 && status)
+	{
+		if (hints.flags & PMinSize)
+		{
+			size[0] = hints.min_width;
+			size[1] = hints.min_height;
+		}
+		else if (hints.flags & PBaseSize)
+		{
+			size[0] = hints.base_width;
+			size[1] = hints.base_height;
+		}
+		
+		if (hints.flags & PBaseSize)
+		{
+			size[2] = hints.base_width;
+			size[3] = hints.base_height;
+		}
+		else
+		{
+			size[2] = size[0];
+			size[3] = size[1];
+		}
+		
+		if (hints.flags & PResizeInc)
+		{
+			size[4] = MAX (hints.width_inc, 0);
+			size[5] = MAX (hints.height_inc, 0);
+		}
+	}
+	
+	g_object_set_data_full (G_OBJECT (win), WW_SIZE_HINTS_KEY, size, g_free);
+	
+	return size;
+}
 
 /**
- * ww_filter_user_windows
- * @windows: List of %WnckWindow<!-- -->s to filter
- * @current_workspace: Only use windows on this workspace. %NULL indicates
- *                     that all windows should be used
- *
- * Extract the user controlled visible windows from a %GList of
- * %WnckWindows.
+ * ww_forget_size_hints
+ * @win: The window whose WM_NORMAL_HINTS changed
  *
- * Return value: A newly allocated list containing only windows that are 
- * not minimized, shaded, or wnck_window_skip_task_list() on the current
- * workspace.
+ * Drop the cached size hints of @win, so they are read again the next time
+ * it is described.
  */
-GList*
-ww_filter_user_windows (GList * windows, WnckWorkspace *current_workspace)
+void
+ww_forget_size_hints (WnckWindow *win)
 {
-	GList       *next;
-	GList       *result;
-	WnckWindow  *win;
-	WnckWorkspace *win_ws;
+	g_return_if_fail (WNCK_IS_WINDOW (win));
+	
+	g_object_set_data (G_OBJECT (win), WW_SIZE_HINTS_KEY, NULL);
+}
 
-	result = NULL;    
+/* Read _NET_FRAME_EXTENTS as left, right, top and bottom. This is a round
+ * trip, so the result is kept until ww_forget_frame_extents() is called */
+static const int*
+get_frame_extents (WnckWindow *win)
+{
+	Atom			type;
+	int				format, result, err, i;
+	unsigned long	n_items, bytes_after;
+	unsigned char	*data;
+	int				*extents;
+	
+	extents = g_object_get_data (G_OBJECT (win), WW_FRAME_EXTENTS_KEY);
+	if (extents)
+		return extents;
 	
-	for (next = windows; next; next = next->next)
+	extents = g_new0 (int, 4);
+	
+	data = NULL;
+	gdk_error_trap_push ();
+	result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+								 wnck_window_get_xid (win),
+								 gdk_x11_get_xatom_by_name ("_NET_FRAME_EXTENTS"),
+								 0, 4, False, XA_CARDINAL, &type, &format,
+								 &n_items, &bytes_after, &data);
+	err = gdk_error_trap_pop ();
+	
+	/* Undecorated, or the window manager doesn't say */
+	if (err == 0 && result == Success && data != NULL &&
+		type == XA_CARDINAL && format == 32 && n_items == 4)
 	{
-		win = WNCK_WINDOW(next->data);
-		if (!wnck_window_is_skip_tasklist (win) &&
-			!wnck_window_is_minimized (win) &&
-			!wnck_window_is_maximized (win) &&
-			!wnck_window_is_shaded (win))
-		{
-			win_ws = wnck_window_get_workspace (win);
-			
-			if (current_workspace == NULL
-			    || (win_ws == current_workspace
-			        && wnck_window_is_in_viewport(win, current_workspace))
-			    || win_ws == NULL)	
-				result = g_list_append (result, win);
-				
-		}
+		for (i = 0; i < 4; i++)
+			extents[i] = MAX (((long *) data)[i], 0);
 	}
+	if (data)
+		XFree (data);
 	
-	return result;
+	g_object_set_data_full (G_OBJECT (win), WW_FRAME_EXTENTS_KEY,
+							extents, g_free);
+	
+	return extents;
 }
 
 /**
- * ww_filter_strut_windows
- * @windows: List of %WnckWindow<!-- -->s to filter
- * @current_workspace: Only use windows on this workspace. %NULL indicates
- *                     that all windows should be used
+ * ww_forget_frame_extents
+ * @win: The window whose _NET_FRAME_EXTENTS changed
  *
- * Extract all windows that should be considered "hard edges", or windows
- * blocking the movement of other windows from %GList of
- * %WnckWindows. The prime example of a "strut" is a standard desktop panel.
+ * Drop the cached frame extents of @win, so they are read again the next
+ * time it is moved.
+ */
+void
+ww_forget_frame_extents (WnckWindow *win)
+{
+	g_return_if_fail (WNCK_IS_WINDOW (win));
+	
+	g_object_set_data (G_OBJECT (win), WW_FRAME_EXTENTS_KEY, NULL);
+}
+
+/**
+ * ww_window_set_geometry
+ * @win: The window to move and resize
+ * @x: Target x coordinate of the frame
+ * @y: Target y coordinate of the frame
+ * @width: Target width of the frame
+ * @height: Target height of the frame
  *
- * Return value: A newly allocated list containing only windows that are 
- * not minimized, maximized, or shaded, and is wnck_window_skip_task_list() and
- * wnck_window_is_pinned().
+ * Ask the window manager to move @win so its frame, decorations included,
+ * covers the given rectangle. This is the geometry wnck_window_get_geometry()
+ * reports and the layouts work with, but wnck_window_set_geometry() takes
+ * the rectangle of the client window, so the frame extents are taken out
+ * first. Nothing is flushed.
  */
-GList*
-ww_filter_strut_windows (GList * windows, WnckWorkspace *current_workspace)
+void
+ww_window_set_geometry (WnckWindow	*win,
+						int			x,
+						int			y,
+						int			width,
+						int			height)
 {
-	GList       *next;
-	GList       *result;
-	WnckWindow  *win;
-	WnckWorkspace *win_ws;
+	const int	*extents;
+	
+	g_return_if_fail (WNCK_IS_WINDOW (win));
+	
+	extents = get_frame_extents (win);
+	
+	wnck_window_set_geometry (win, WNCK_WINDOW_GRAVITY_STATIC,
+							  WW_MOVERESIZE_FLAGS,
+							  x + extents[0],
+							  y + extents[2],
+							  MAX (width - extents[0] - extents[1], 1),
+							  MAX (height - extents[2] - extents[3], 1));
+}
 
-	result = NULL;    
+/**
+ * ww_describe_window
+ * @win: The window to describe
+ * @current_workspace: The workspace to check viewport visibility against.
+ *                     May be %NULL
+ * @desc: Return location for the description
+ *
+ * Capture everything the layout engine needs to know about @win in one go,
+ * so the classification and the layouts never have to call back into
+ * libwnck. The data member of @desc points to @win.
+ */
+void
+ww_describe_window (WnckWindow		*win,
+					WnckWorkspace	*current_workspace,
+					WwWindowDesc	*desc)
+{
+	WnckWorkspace	*win_ws;
+	WnckClassGroup	*class_group;
+	const gchar		*class_name;
+	const int		*size, *extents;
+	
+	wnck_window_get_geometry (win,
+							  &desc->geometry.x, &desc->geometry.y,
+							  &desc->geometry.width, &desc->geometry.height);
+	
+	desc->flags = 0;
+	if (wnck_window_is_active (win))
+		desc->flags |= WW_WINDOW_ACTIVE;
+	if (wnck_window_is_skip_tasklist (win))
+		desc->flags |= WW_WINDOW_SKIP_TASKLIST;
+	if (wnck_window_is_minimized (win))
+		desc->flags |= WW_WINDOW_MINIMIZED;
+	if (wnck_window_is_maximized (win))
+		desc->flags |= WW_WINDOW_MAXIMIZED;
+	if (wnck_window_is_shaded (win))
+		desc->flags |= WW_WINDOW_SHADED;
 	
-	for (next = windows; next; next = next->next)
+	win_ws = wnck_window_get_workspace (win);
+	if (win_ws == NULL)
 	{
-    win = WNCK_WINDOW(next->data);
-    
-    /* Debug code to print out all window geometries: */
-    /*int x, y, w, h;
-    wnck_window_get_geometry(win, &x, &y, &w, &h);
-    g_debug ("\"%s\": (%d, %d)@%dx%d",
-             wnck_window_get_name(win), x, y, w, h);*/
-    		
-		if (wnck_window_get_window_type(win) == WNCK_WINDOW_DOCK)
-		{
-			win_ws = wnck_window_get_workspace (win);
-			
-			if (current_workspace == NULL ||
-				win_ws == current_workspace ||				
-				win_ws == NULL)	
-				result = g_list_append (result, win);
-		}  
-  }
+		desc->workspace = WW_WORKSPACE_ALL;
+	}
+	else
+	{
+		desc->workspace = wnck_workspace_get_number (win_ws);
+		if (win_ws == current_workspace &&
+			wnck_window_is_in_viewport (win, current_workspace))
+			desc->flags |= WW_WINDOW_IN_VIEWPORT;
+	}
 	
-	return result;
+	switch (wnck_window_get_window_type (win))
+	{
+		case WNCK_WINDOW_NORMAL:
+			desc->type = WW_WINDOW_TYPE_NORMAL;
+			break;
+		case WNCK_WINDOW_DOCK:
+			desc->type = WW_WINDOW_TYPE_DOCK;
+			break;
+		default:
+			desc->type = WW_WINDOW_TYPE_OTHER;
+			break;
+	}
+	
+	/* The engine works on frames, so the hints are too */
+	size = get_size_hints (win);
+	extents = get_frame_extents (win);
+	desc->base_width = size[2] + extents[0] + extents[1];
+	desc->base_height = size[3] + extents[2] + extents[3];
+	desc->min_width = size[0] > 0 ? size[0] + extents[0] + extents[1] : 0;
+	desc->min_height = size[1] > 0 ? size[1] + extents[2] + extents[3] : 0;
+	desc->width_inc = size[4];
+	desc->height_inc = size[5];
+	
+	/* For the rules of user layouts, see ww-program.c */
+	class_group = wnck_window_get_class_group (win);
+	class_name = class_group ? wnck_class_group_get_res_class (class_group)
+							 : NULL;
+	desc->class_hash = class_name ? g_str_hash (class_name) : 0;
+	
+	desc->data = win;
 }
 
 /**
  * ww_apply_layout_by_name
  * @layout_name: The name of the layout to apply
  *
+ * @error: Return location for a #GError or %NULL
+ *
  * Apply a given layout to the default screen by looking up the relevant
  * #WwLayout based on its name.
+ *
+ * Return value: %FALSE if the layout is unknown or failed
  */
-void
-ww_apply_layout_by_name (const gchar * layout_name)
+gboolean
+ww_apply_layout_by_name (const gchar * layout_name, GError **error)
 {
 	WnckScreen *screen;
-	WnckWorkspace   *current_ws;
-	GList *windows, *struts;
+	WwSnapshot *snapshot;
 	WnckWindow *active;
 	const WwLayout *layout;
-	GError *error;
-	
-	screen = wnck_screen_get_default ();
-	wnck_screen_force_update (screen);
+	WwPlan *plan;
+	GError *handler_error;
+	gint64 start, phase_start;
 	
-	current_ws = wnck_screen_get_active_workspace (screen);
-	windows = wnck_screen_get_windows (screen);
-	struts = ww_filter_strut_windows (windows, current_ws);
-	windows = ww_filter_user_windows (windows, current_ws);
-	active = wnck_screen_get_active_window (screen);
+	start = ww_stats_now ();
 	
 	/* Check that we know the requested layout */
 	layout = ww_get_layout (layout_name);
 	if (!layout)
 	{
-		g_printerr ("No such layout: '%s'. Try running with --layouts to "
-					"list possible layouts\n", layout_name);
-		return;
+		g_set_error (error, WW_ERROR, WW_ERROR_NO_SUCH_LAYOUT,
+					 "No such layout: '%s'. Try running with --layouts to "
+					 "list possible layouts", layout_name);
+		return FALSE;
 	}
 	
-	/* Apply the layout */
-	error = NULL;
-	layout->handler (screen, windows, struts, active, &error);
-	g_list_free (windows);
-	g_list_free (struts);
+	/* The model is kept current by libwnck signals, so there is no need
+	 * for a wnck_screen_force_update() here. Layouts that only switch
+	 * windows go to the neighbour graph and don't need the snapshot */
+	phase_start = ww_stats_now ();
+	screen = ww_model_get_screen ();
+	snapshot = (layout->flags & WW_LAYOUT_NO_SNAPSHOT) ? NULL
+													   : ww_model_get_snapshot ();
+	active = ww_model_get_active ();
+	ww_stats_record (layout->name, WW_PHASE_REFRESH, phase_start);
+	
+	/* The snapshot already has the geometries, so this is cheap */
+	if (!(layout->flags & WW_LAYOUT_NO_UNDO))
+		ww_undo_record (snapshot);
+	
+	/* Let the layout plan its changes */
+	handler_error = NULL;
+	plan = ww_plan_new ();
+	phase_start = ww_stats_now ();
+	if (layout->handler)
+		layout->handler (screen, snapshot, active, plan, &handler_error);
+	else
+		ww_apply_engine_full (layout->compute, layout->data, snapshot, plan);
+	ww_stats_record (layout->name, WW_PHASE_COMPUTE, phase_start);
+	
+	if (handler_error)
+	{
+		g_propagate_error (error, handler_error);
+		ww_plan_free (plan);
+		return FALSE;
+	}
 	
-	if (error)
+	/* Apply the layout */
+	phase_start = ww_stats_now ();
+	if (_dry_run)
+		ww_plan_print (plan);
+	else
 	{
-		g_printerr ("Failed to apply layout '%s'. Error was:\n%s",
-					layout_name, error->message);
-		g_error_free (error);
-		return;
-	}	
+		if (ww_plan_commit (plan) > 0 && !(layout->flags & WW_LAYOUT_NO_UNDO))
+			ww_undo_push ();
+		ww_settle_start (layout->name);
+	}
+	ww_stats_record (layout->name, WW_PHASE_COMMIT, phase_start);
+	ww_stats_startup_done (layout->name);
+	
+	ww_plan_free (plan);
+	
+	ww_stats_record (layout->name, WW_PHASE_TOTAL, start);
+	
+	return TRUE;
 }
 
-#define is_high(w, h) (h > w)
-#define is_broad(w, h) (w > h)
-
 /**
  * ww_calc_bounds
- * @screen: The screen for which to calculate the bounds
- * @struts: A list of %WnckWindow<!---->s that should be treated as
- *          blocking elements on the desktop. Eg. panels and docks
- * @x: Return value for the left side of the bounding box
- * @y: Return value for the top of the box
- * @right: Return coordinate for the right side of the bounding box
- * @bottom: Return value for the bottom coordinate of the bounding box
+ * @snapshot: The desktop to calculate the bounds of
+ * @bounds: Return location for the bounding box
  *
- * Calculate the maximal rect within a set of blocking windows.
- * For simplicity this method assumes that all struts are along the screen
- * edges and expand over the entire screen edge. Ie a standard panel setup.
+ * Get the usable area of @snapshot. See ww_engine_get_bounds().
  */
 void
-ww_calc_bounds (WnckScreen *screen,
-                GList *struts, 
-                int *left, 
-                int *top, 
-                int *right, 
-                int *bottom)
+ww_calc_bounds (WwSnapshot *snapshot, WwRect *bounds)
 {
-	GList		*next;
-	WnckWindow  *win;
-	int wx, wy, ww, wh; /* current window geom */
-	int edge_l, edge_t, edge_b, edge_r;
-	int screen_w, screen_h;
-	
-	edge_l = 0;
-	edge_t = 0;
-	edge_r = wnck_screen_get_width (screen);
-	edge_b = wnck_screen_get_height (screen);
-	
-	screen_w = edge_r;
-	screen_h = edge_b;
-	
-	for (next = struts; next; next = next->next)
-	{	
-		win = WNCK_WINDOW (next->data);
-		wnck_window_get_geometry (win, &wx, &wy, &ww, &wh);
-		
-		/* Left side strut */
-		if (is_high(ww, wh) && wx == 0) {
-			edge_l = MAX(edge_l, ww);
-		}
-		
-		/* Top struct */
-		else if (is_broad(ww, wh) && wy == 0) {
-			edge_t = MAX (edge_t, wh);
-		}
-		
-		/* Right side strut */
-		else if (is_high(ww, wh) && (wx+ww) == screen_w) {
-			edge_r = MIN(edge_r, wx);
-		}
-		
-		/* Bottom struct */
-		else if (is_broad(ww, wh) && (wy+wh) == screen_h) {
-			edge_b = MIN (edge_b, wy);
-		}
-		
-		else {
-			g_warning ("Desktop layout contains floating element at "
-					   "(%d, %d)@%dx%d", wx, wy, ww, wh);
+	WwEngineInput	input;
+	
+	ww_snapshot_get_input (snapshot, &input);
+	ww_engine_get_bounds (&input, bounds);
+}
+
+/* The input a layout last left each monitor in, see monitor_settled() */
+typedef struct
+{
+	WwEngineFunc	func;
+	gconstpointer	data;
+	int				monitor;
+	guint32			signature;
+} WwSettled;
+
+static GArray *settled = NULL;		/* of WwSettled */
+static GArray *monitor_windows = NULL;	/* of WwWindowDesc */
+
+/* Hash everything a layout looks at. If @cells is not %NULL it replaces the
+ * geometries of the windows */
+static guint32
+input_signature (const WwEngineInput *input, const WwRect *cells)
+{
+	const WwRect	*geometry;
+	guint32			hash;
+	int				i;
+
+	hash = 2166136261u;
+#define MIX(v) hash = (hash ^ (guint32) (v)) * 16777619u
+	MIX (input->workarea.x);
+	MIX (input->workarea.y);
+	MIX (input->workarea.width);
+	MIX (input->workarea.height);
+	for (i = 0; i < input->n_windows; i++)
+	{
+		geometry = cells ? &cells[i] : &input->windows[i].geometry;
+		MIX (GPOINTER_TO_SIZE (input->windows[i].data));
+		MIX (input->windows[i].flags);
+		MIX (geometry->x);
+		MIX (geometry->y);
+		MIX (geometry->width);
+		MIX (geometry->height);
+	}
+#undef MIX
+
+	return hash;
+}
+
+static WwSettled*
+monitor_settled (WwEngineFunc func, gconstpointer data, int monitor)
+{
+	WwSettled	*entry;
+	WwSettled	new_entry;
+	guint		i;
+
+	if (settled == NULL)
+		settled = g_array_new (FALSE, FALSE, sizeof (WwSettled));
+
+	for (i = 0; i < settled->len; i++)
+	{
+		entry = &g_array_index (settled, WwSettled, i);
+		if (entry->func == func && entry->data == data &&
+			entry->monitor == monitor)
+			return entry;
+	}
+
+	new_entry.func = func;
+	new_entry.data = data;
+	new_entry.monitor = monitor;
+	new_entry.signature = 0;
+	g_array_append_val (settled, new_entry);
+
+	return &g_array_index (settled, WwSettled, settled->len - 1);
+}
+
+/* Run @func on @input and write the windows it moves to @plan. If
+ * @signature is not %NULL it is set to the signature of the result */
+static gboolean
+apply_input (WwEngineFunc			func,
+			 const WwEngineInput	*input,
+			 WwPlan					*plan,
+			 guint32				*signature)
+{
+	WwRect			*cells;
+	int				i;
+	gboolean		result;
+	
+	cells = g_new (WwRect, input->n_windows);
+	
+	result = func (input, cells);
+	if (result)
+	{
+		for (i = 0; i < input->n_windows; i++)
+		{
+			/* Leave windows the layout didn't touch out of the plan */
+			if (memcmp (&cells[i], &input->windows[i].geometry,
+						sizeof (WwRect)) == 0)
+				continue;
+			
+			ww_plan_set_geometry (plan, input->windows[i].data,
+								  cells[i].x, cells[i].y,
+								  cells[i].width, cells[i].height);
 		}
 	}
 	
-	g_debug ("Calculated desktop bounds (%d, %d), (%d, %d)",
-			 edge_l, edge_t, edge_r, edge_b);
+	if (signature)
+		*signature = input_signature (input, result ? cells : NULL);
+	
+	g_free (cells);
 	
-	*left = edge_l;
-	*top = edge_t;
-	*right = edge_r;
-	*bottom = edge_b;
+	return result;
+}
+
+static gboolean
+apply_on_monitor (WwEngineFunc	func,
+				  gconstpointer	data,
+				  WwSnapshot	*snapshot,
+				  int			monitor,
+				  WwPlan		*plan)
+{
+	WwEngineInput	input;
+	WwSettled		*entry;
+	guint32			signature;
+	gboolean		result;
+	
+	if (monitor_windows == NULL)
+		monitor_windows = g_array_new (FALSE, FALSE, sizeof (WwWindowDesc));
+	
+	ww_snapshot_get_monitor_input (snapshot, monitor, monitor_windows, &input);
+	if (input.n_windows == 0)
+		return FALSE;
+	input.data = data;
+	
+	/* Nothing has changed on the monitor since the layout was applied */
+	entry = monitor_settled (func, data, monitor);
+	if (entry->signature != 0 &&
+		entry->signature == input_signature (&input, NULL))
+	{
+		g_debug ("Monitor %d is unchanged, skipping it", monitor);
+		return FALSE;
+	}
+	
+	result = apply_input (func, &input, plan, &signature);
+	
+	/* A dry run doesn't change anything */
+	if (!_dry_run)
+		entry->signature = signature;
+	
+	return result;
 }
 
 /**
- * ww_window_center
- * @win:
- * @center_x:
- * @center_y:
+ * ww_apply_engine
+ * @func: The layout function to run
+ * @snapshot: The windows and struts to lay out
+ * @plan: The plan to write the new geometries to
  *
- * Return value: The return value is written to @center_x and @center_y and
- *               represents the center of gravity for @win
+ * Run a pure %WwEngineFunc on a snapshot of libwnck windows and write the
+ * result to @plan, see ww_apply_engine_full().
+ *
+ * Return value: %TRUE if @func returned %TRUE for any monitor
  */
-static void
-ww_window_center (WnckWindow *win, int *center_x, int *center_y)
+gboolean
+ww_apply_engine (WwEngineFunc	func,
+				 WwSnapshot		*snapshot,
+				 WwPlan			*plan)
 {
-	int x, y, w, h;
-
-	wnck_window_get_geometry (win, &x, &y, &w, &h);
-	*center_x = x + (w/2);
-	*center_y = y + (h/2);	
+	return ww_apply_engine_full (func, NULL, snapshot, plan);
 }
 
-static double
-ww_euclidian_distance (int x1, int y1, int x2, int y2)
+/**
+ * ww_apply_engine_full
+ * @func: The layout function to run
+ * @data: The data member of the input @func gets
+ * @snapshot: The windows and struts to lay out
+ * @plan: The plan to write the new geometries to
+ *
+ * Run a pure %WwEngineFunc on a snapshot of libwnck windows and write the
+ * result to @plan. Windows the layout leaves alone are not added to the
+ * plan. Layouts without a handler are applied this way, with their data.
+ *
+ * If @snapshot has monitors @func is run on each monitor separately, with
+ * the windows on that monitor. Monitors where nothing has changed since
+ * @func was last applied to them with the same @data are skipped.
+ *
+ * Return value: %TRUE if @func returned %TRUE for any monitor
+ */
+gboolean
+ww_apply_engine_full (WwEngineFunc	func,
+					  gconstpointer	data,
+					  WwSnapshot	*snapshot,
+					  WwPlan		*plan)
 {
-	return sqrt((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2));
+	WwEngineInput	input;
+	gboolean		result;
+	guint			i;
+	
+	if (snapshot->monitors->len == 0)
+	{
+		ww_snapshot_get_input (snapshot, &input);
+		input.data = data;
+		return apply_input (func, &input, plan, NULL);
+	}
+	
+	result = FALSE;
+	for (i = 0; i < snapshot->monitors->len; i++)
+		result |= apply_on_monitor (func, data, snapshot, i, plan);
+	
+	return result;
 }
 
 /**
- * ww_x_weighted_distance
- * @x1:
- * @y1:
- * @x2:
- * @y2:
+ * ww_apply_engine_active
+ * @func: The layout function to run
+ * @snapshot: The windows and struts to lay out
+ * @plan: The plan to write the new geometries to
  *
- * Calculate a non-euclidian distance between two points that is stretched in
- * x-dimension, making differences in the x-dimension bigger.
+ * Like ww_apply_engine(), but only lay out the monitor of the active
+ * window. Nothing is done if no window in @snapshot is active.
  *
- * Return value: A non-euclidian distance measure between the two points
- *               (@x1,@y1) and (@x2,@y2) that is skewed to make differences
- *               in the x-dimension more important
+ * Return value: The return value of @func
  */
-static double
-ww_x_weighted_distance (int x1, int y1, int x2, int y2)
+gboolean
+ww_apply_engine_active (WwEngineFunc	func,
+						WwSnapshot		*snapshot,
+						WwPlan			*plan)
 {
-	return sqrt( (x1-x2)*(x1-x2)*2 + (y1-y2)*(y1-y2));
+	WwWindowDesc	*desc;
+	WwEngineInput	input;
+	guint			i;
+	
+	if (snapshot->monitors->len == 0)
+	{
+		ww_snapshot_get_input (snapshot, &input);
+		return apply_input (func, &input, plan, NULL);
+	}
+	
+	for (i = 0; i < snapshot->windows->len; i++)
+	{
+		desc = &g_array_index (snapshot->windows, WwWindowDesc, i);
+		if (desc->flags & WW_WINDOW_ACTIVE)
+			return apply_on_monitor (func, NULL, snapshot, desc->monitor,
+									 plan);
+	}
+	
+	g_debug ("No active window");
+	return FALSE;
 }
 
 /**
- * ww_y_weighted_distance
- * @x1:
- * @y1:
- * @x2:
- * @y2:
- *
- * Calculate a non-euclidian distance between two points that is stretched in
- * y-dimension, making differences in the y-dimension bigger.
+ * ww_window_center
+ * @win:
+ * @center_x:
+ * @center_y:
  *
- * Return value: A non-euclidian distance measure between the two points
- *               (@x1,@y1) and (@x2,@y2) that is skewed to make differences
- *               in the y-dimension more important
+ * Return value: The return value is written to @center_x and @center_y and
+ *               represents the center of gravity for @win
  */
-static double
-ww_y_weighted_distance (int x1, int y1, int x2, int y2)
+void
+ww_window_center (WnckWindow *win, int *center_x, int *center_y)
 {
-	return sqrt((x1-x2)*(x1-x2) + (y1-y2)*(y1-y2)*2 );
+	int x, y, w, h;
+
+	wnck_window_get_geometry (win, &x, &y, &w, &h);
+	*center_x = x + (w/2);
+	*center_y = y + (h/2);	
 }
 
 /**
  * ww_find_neighbour
- * @screen:
- * @windows:
- * @active:
- * @direction:
+ * @index: A #WwSpatialIndex over the centres of the candidate windows
+ * @active: The window to start from
+ * @direction: The direction to look in
+ *
+ * Look up the nearest window in the given direction. The lookup only
+ * touches the index, so it costs no round trips to the X server.
  *
- * Return value: The neighbouring window from @windows in the given direction
+ * Return value: The neighbouring window from @index in the given direction
  *               or %NULL in case no window is found or @active is %NULL
  */
 WnckWindow*
-ww_find_neighbour (WnckScreen	*screen,
-                   GList		*windows,
-                   WnckWindow	*active,
-                   WwDirection	direction)
+ww_find_neighbour (WwSpatialIndex	*index,
+                   WnckWindow		*active,
+                   WwDirection		direction)
 {
 	WnckWindow	*neighbour;
-	GList		*next;
 	int			ax, ay, aw, ah; /* active window geometry */
-	int			wx, wy; /* geometry for currently checked window */ 
-	int			nx, ny; /* geometry of neighbour */
-	double		wdist, ndist; /* distance to active window */
 
-	neighbour = NULL;
+	g_return_val_if_fail (index != NULL, NULL);
 	
-	g_return_val_if_fail (WNCK_IS_SCREEN(screen), NULL);
-	
-	if (g_list_length(windows) == 0)
+	if (ww_spatial_index_get_size (index) == 0)
     {
 		return NULL;
     }
@@ -349,9 +686,6 @@ ww_find_neighbour (WnckScreen	*screen,
 		return NULL;
 	}
 
-	nx = ny = 0;
-	ndist = 100000;
-
 	wnck_window_get_geometry (active, &ax, &ay, &aw, &ah);
 	g_debug("Active window '%s' (%d, %d) @ %d x %d",
 	        wnck_window_get_name (active), ax, ay, aw, ah);
@@ -359,70 +693,7 @@ ww_find_neighbour (WnckScreen	*screen,
 	/* Set ax and ay to the center of grav. for active */
 	ww_window_center (active, &ax, &ay);
 	
-	if ( direction == LEFT )
-	{
-		for ( next = windows; next; next = next->next )
-		{
-			ww_window_center (WNCK_WINDOW (next->data), &wx, &wy);
-			wdist = ww_y_weighted_distance (wx, wy, ax, ay);
-			if ( wx < ax )
-			{
-				if ( wdist < ndist )
-				{
-					neighbour = WNCK_WINDOW (next->data);
-					ndist = wdist;
-				}
-			} 
-		}
-	}
-	else if ( direction == RIGHT )
-	{
-		for ( next = windows; next; next = next->next )
-		{
-			ww_window_center (WNCK_WINDOW (next->data), &wx, &wy);
-			wdist = ww_y_weighted_distance (wx, wy, ax, ay);
-			if ( wx > ax )
-			{
-				if ( wdist < ndist )
-				{
-					neighbour = WNCK_WINDOW (next->data);
-					ndist = wdist;
-				}
-			}
-		}
-	}
-	else if ( direction == DOWN )
-	{
-		for ( next = windows; next; next = next->next )
-		{
-			ww_window_center (WNCK_WINDOW (next->data), &wx, &wy);
-			wdist = ww_x_weighted_distance (wx, wy, ax, ay);
-			if ( wy > ay )
-			{
-				if ( wdist < ndist )
-				{
-					neighbour = WNCK_WINDOW (next->data);
-					ndist = wdist;
-				}
-			}
-		}
-	}
-	else if ( direction == UP )
-	{
-		for ( next = windows; next; next = next->next )
-		{
-			ww_window_center (WNCK_WINDOW (next->data), &wx, &wy);
-			wdist = ww_x_weighted_distance (wx, wy, ax, ay);
-			if ( wy < ay )
-			{
-				if ( wdist < ndist )
-				{
-					neighbour = WNCK_WINDOW (next->data);
-					ndist = wdist;
-				}
-			}
-		}
-	}
+	neighbour = ww_spatial_index_find_neighbour (index, ax, ay, direction);
 
 	if (neighbour)
 		g_debug ("Found neighbour '%s'",
@@ -441,4 +712,16 @@ void
 ww_set_event_time (guint32 event_time)
 {
 	_event_time = event_time;
-}
\ No newline at end of file
+}
+
+gboolean
+ww_get_dry_run (void)
+{
+	return _dry_run;
+}
+
+void
+ww_set_dry_run (gboolean dry_run)
+{
+	_dry_run = dry_run;
+}
@@ -0,0 +1,395 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 4; tab-width: 4 -*- */
+/*
+ * This file is part of WinWrangler.
+ * Copyright (C) Mikkel Kamstrup Erlandsen 2008 <mikkel.kamstrup@gmail.com>
+ *
+ *  WinWrangler is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  WinWrangler is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with WinWranger.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The workarea is the part of the screen not reserved by panels. It is
+ * calculated from the EWMH _NET_WM_STRUT_PARTIAL (or _NET_WM_STRUT) of the
+ * windows and the _NET_WORKAREA of the root window, and cached per
+ * workspace and monitor. The properties are only read again after a
+ * PropertyNotify on one of them, or when docks, workspaces or monitors
+ * come and go.
+ */
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "winwrangler.h"
+
+/* A strut and the workspace of the window reserving it */
+typedef struct
+{
+	WwStrut		strut;
+	int			workspace;
+} WwWorkspaceStrut;
+
+static WnckScreen	*workarea_screen = NULL;
+static gboolean		workarea_valid = FALSE;
+static GArray		*workarea_struts = NULL;	/* of WwWorkspaceStrut */
+static GArray		*workarea_scratch = NULL;	/* of WwStrut */
+static GArray		*workarea_net = NULL;		/* of WwRect, from _NET_WORKAREA */
+static GArray		*workarea_cache = NULL;		/* of WwRect */
+static int			workarea_n_workspaces = 0;
+static int			workarea_n_monitors = 0;
+
+static Atom			atom_strut_partial = None;
+static Atom			atom_strut = None;
+static Atom			atom_workarea = None;
+static Atom			atom_n_desktops = None;
+
+/*
+ * Read a CARDINAL[] property. Returns the number of values read into
+ * @values, which must be freed with XFree(), or 0 if the property is not
+ * set.
+ */
+static gulong
+get_cardinals (Window xwindow, Atom atom, long **values)
+{
+	Atom			type;
+	int				format, err;
+	unsigned long	n_items, bytes_after;
+	unsigned char	*data;
+	int				result;
+
+	data = NULL;
+	gdk_error_trap_push ();
+	result = XGetWindowProperty (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+								 xwindow, atom, 0, G_MAXLONG, False,
+								 XA_CARDINAL, &type, &format, &n_items,
+								 &bytes_after, &data);
+	err = gdk_error_trap_pop ();
+
+	if (err != 0 || result != Success || data == NULL)
+		return 0;
+
+	if (type != XA_CARDINAL || format != 32 || n_items == 0)
+	{
+		XFree (data);
+		return 0;
+	}
+
+	*values = (long *) data;
+	return n_items;
+}
+
+/* Read the strut of @window. Returns %FALSE if it doesn't reserve space */
+static gboolean
+read_strut (WnckWindow *window, WwStrut *strut)
+{
+	Window	xwindow;
+	long	*v;
+	gulong	n;
+
+	xwindow = wnck_window_get_xid (window);
+
+	n = get_cardinals (xwindow, atom_strut_partial, &v);
+	if (n >= 12)
+	{
+		strut->left = v[0];
+		strut->right = v[1];
+		strut->top = v[2];
+		strut->bottom = v[3];
+		strut->left_start_y = v[4];
+		strut->left_end_y = v[5];
+		strut->right_start_y = v[6];
+		strut->right_end_y = v[7];
+		strut->top_start_x = v[8];
+		strut->top_end_x = v[9];
+		strut->bottom_start_x = v[10];
+		strut->bottom_end_x = v[11];
+		XFree (v);
+		return TRUE;
+	}
+	if (n > 0)
+		XFree (v);
+
+	/* The old _NET_WM_STRUT reserves the whole screen edge */
+	n = get_cardinals (xwindow, atom_strut, &v);
+	if (n >= 4)
+	{
+		strut->left = v[0];
+		strut->right = v[1];
+		strut->top = v[2];
+		strut->bottom = v[3];
+		strut->left_start_y = strut->right_start_y = 0;
+		strut->top_start_x = strut->bottom_start_x = 0;
+		strut->left_end_y = strut->right_end_y = G_MAXINT;
+		strut->top_end_x = strut->bottom_end_x = G_MAXINT;
+		XFree (v);
+		return TRUE;
+	}
+	if (n > 0)
+		XFree (v);
+
+	return FALSE;
+}
+
+/* Read the struts and _NET_WORKAREA and empty the cache */
+static void
+workarea_reload (void)
+{
+	WwWorkspaceStrut	ws_strut;
+	WnckWorkspace		*win_ws;
+	WwRect				rect;
+	GList				*next;
+	long				*v;
+	gulong				n, i;
+
+	g_array_set_size (workarea_struts, 0);
+	for (next = wnck_screen_get_windows (workarea_screen); next; next = next->next)
+	{
+		if (!read_strut (WNCK_WINDOW (next->data), &ws_strut.strut))
+			continue;
+
+		win_ws = wnck_window_get_workspace (WNCK_WINDOW (next->data));
+		ws_strut.workspace = win_ws ? wnck_workspace_get_number (win_ws)
+									: WW_WORKSPACE_ALL;
+		g_array_append_val (workarea_struts, ws_strut);
+	}
+
+	g_array_set_size (workarea_net, 0);
+	n = get_cardinals (GDK_ROOT_WINDOW (), atom_workarea, &v);
+	for (i = 0; i + 3 < n; i += 4)
+	{
+		rect.x = v[i];
+		rect.y = v[i + 1];
+		rect.width = v[i + 2];
+		rect.height = v[i + 3];
+		g_array_append_val (workarea_net, rect);
+	}
+	if (n > 0)
+		XFree (v);
+
+	workarea_n_workspaces = wnck_screen_get_workspace_count (workarea_screen);
+	workarea_n_monitors = gdk_screen_get_n_monitors (gdk_screen_get_default ());
+
+	/* One slot for the whole screen and one per monitor on each workspace,
+	 * calculated on demand */
+	rect.x = rect.y = rect.width = rect.height = -1;
+	g_array_set_size (workarea_cache, 0);
+	for (i = 0; i < workarea_n_workspaces * (workarea_n_monitors + 1); i++)
+		g_array_append_val (workarea_cache, rect);
+
+	g_debug ("Read %u struts and %u workareas", workarea_struts->len,
+			 workarea_net->len);
+
+	workarea_valid = TRUE;
+}
+
+static void
+workarea_calc (int workspace, int monitor, WwRect *workarea)
+{
+	WwWorkspaceStrut	*ws_strut;
+	GdkRectangle		mon;
+	WwRect				screen, area;
+	guint				i;
+
+	screen.x = 0;
+	screen.y = 0;
+	screen.width = wnck_screen_get_width (workarea_screen);
+	screen.height = wnck_screen_get_height (workarea_screen);
+
+	/* The window manager knows best, but _NET_WORKAREA only covers the
+	 * whole screen */
+	if (monitor == WW_MONITOR_ALL && workspace >= 0 &&
+		workspace < workarea_net->len)
+	{
+		*workarea = g_array_index (workarea_net, WwRect, workspace);
+		return;
+	}
+
+	if (monitor == WW_MONITOR_ALL)
+	{
+		area = screen;
+	}
+	else
+	{
+		gdk_screen_get_monitor_geometry (gdk_screen_get_default (), monitor,
+										 &mon);
+		area.x = mon.x;
+		area.y = mon.y;
+		area.width = mon.width;
+		area.height = mon.height;
+	}
+
+	g_array_set_size (workarea_scratch, 0);
+	for (i = 0; i < workarea_struts->len; i++)
+	{
+		ws_strut = &g_array_index (workarea_struts, WwWorkspaceStrut, i);
+		if (workspace == WW_WORKSPACE_ALL ||
+			ws_strut->workspace == WW_WORKSPACE_ALL ||
+			ws_strut->workspace == workspace)
+			g_array_append_val (workarea_scratch, ws_strut->strut);
+	}
+
+	ww_engine_calc_workarea (&screen, &area,
+							 (const WwStrut *) workarea_scratch->data,
+							 workarea_scratch->len, workarea);
+}
+
+static GdkFilterReturn
+on_x_event (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
+{
+	XEvent	*xevent;
+
+	xevent = (XEvent *) gdk_xevent;
+
+	if (xevent->type == PropertyNotify &&
+		(xevent->xproperty.atom == atom_strut_partial ||
+		 xevent->xproperty.atom == atom_strut ||
+		 xevent->xproperty.atom == atom_workarea ||
+		 xevent->xproperty.atom == atom_n_desktops))
+		ww_workarea_invalidate ();
+
+	return GDK_FILTER_CONTINUE;
+}
+
+static void
+on_dock_changed (WnckScreen *screen, WnckWindow *window, gpointer data)
+{
+	if (wnck_window_get_window_type (window) == WNCK_WINDOW_DOCK)
+		ww_workarea_invalidate ();
+}
+
+static void
+on_workspaces_changed (WnckScreen		*screen,
+					   WnckWorkspace	*workspace,
+					   gpointer			data)
+{
+	ww_workarea_invalidate ();
+}
+
+static void
+on_monitors_changed (GdkScreen *screen, gpointer data)
+{
+	ww_workarea_invalidate ();
+}
+
+/**
+ * ww_workarea_init
+ * @screen: The screen to track the workarea of
+ *
+ * Start listening for changes to the struts and workarea of @screen.
+ * Calling this function more than once is harmless.
+ */
+void
+ww_workarea_init (WnckScreen *screen)
+{
+	GdkWindow	*root;
+
+	g_return_if_fail (WNCK_IS_SCREEN (screen));
+
+	if (workarea_screen)
+		return;
+
+	workarea_screen = screen;
+	workarea_struts = g_array_new (FALSE, FALSE, sizeof (WwWorkspaceStrut));
+	workarea_scratch = g_array_new (FALSE, FALSE, sizeof (WwStrut));
+	workarea_net = g_array_new (FALSE, FALSE, sizeof (WwRect));
+	workarea_cache = g_array_new (FALSE, FALSE, sizeof (WwRect));
+
+	atom_strut_partial = gdk_x11_get_xatom_by_name ("_NET_WM_STRUT_PARTIAL");
+	atom_strut = gdk_x11_get_xatom_by_name ("_NET_WM_STRUT");
+	atom_workarea = gdk_x11_get_xatom_by_name ("_NET_WORKAREA");
+	atom_n_desktops = gdk_x11_get_xatom_by_name ("_NET_NUMBER_OF_DESKTOPS");
+
+	/* libwnck selects PropertyChangeMask on the client windows, but not
+	 * necessarily on the root window */
+	root = gdk_get_default_root_window ();
+	gdk_window_set_events (root, gdk_window_get_events (root)
+								 | GDK_PROPERTY_CHANGE_MASK);
+	gdk_window_add_filter (NULL, on_x_event, NULL);
+
+	g_signal_connect (screen, "window-opened",
+					  G_CALLBACK (on_dock_changed), NULL);
+	g_signal_connect (screen, "window-closed",
+					  G_CALLBACK (on_dock_changed), NULL);
+	g_signal_connect (screen, "workspace-created",
+					  G_CALLBACK (on_workspaces_changed), NULL);
+	g_signal_connect (screen, "workspace-destroyed",
+					  G_CALLBACK (on_workspaces_changed), NULL);
+	g_signal_connect (gdk_screen_get_default (), "monitors-changed",
+					  G_CALLBACK (on_monitors_changed), NULL);
+	g_signal_connect (gdk_screen_get_default (), "size-changed",
+					  G_CALLBACK (on_monitors_changed), NULL);
+
+	workarea_valid = FALSE;
+}
+
+/**
+ * ww_workarea_invalidate
+ *
+ * Throw away the cached workareas. They are recalculated when they are
+ * needed again.
+ */
+void
+ww_workarea_invalidate (void)
+{
+	if (workarea_valid)
+		g_debug ("Workarea changed");
+
+	workarea_valid = FALSE;
+}
+
+/**
+ * ww_workarea_get
+ * @workspace: The number of the workspace, or %WW_WORKSPACE_ALL to take
+ *             the struts on all workspaces into account
+ * @monitor: The number of the monitor, or %WW_MONITOR_ALL for the whole
+ *           screen
+ * @workarea: Return location for the workarea
+ *
+ * Get the part of a monitor on a workspace that is not reserved by panels
+ * or docks. Apart from the first call after a change this is a lookup in
+ * the cache.
+ */
+void
+ww_workarea_get (int workspace, int monitor, WwRect *workarea)
+{
+	WwRect	*cached;
+	guint	slot;
+
+	g_return_if_fail (workarea_screen != NULL);
+	g_return_if_fail (workarea != NULL);
+
+	if (!workarea_valid)
+		workarea_reload ();
+
+	g_return_if_fail (monitor >= WW_MONITOR_ALL &&
+					  monitor < workarea_n_monitors);
+
+	/* Don't bother caching the unusual cases */
+	if (workspace < 0 || workspace >= workarea_n_workspaces)
+	{
+		workarea_calc (workspace, monitor, workarea);
+		return;
+	}
+
+	slot = workspace * (workarea_n_monitors + 1) + (monitor + 1);
+	cached = &g_array_index (workarea_cache, WwRect, slot);
+	if (cached->width < 0)
+	{
+		workarea_calc (workspace, monitor, cached);
+		g_debug ("Workarea of workspace %d monitor %d is (%d, %d)@%dx%d",
+				 workspace, monitor, cached->x, cached->y,
+				 cached->width, cached->height);
+	}
+
+	*workarea = *cached;
+}